@@ -2,7 +2,7 @@ QT       += core gui widgets serialport
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
-CONFIG += c++11
+CONFIG += c++17
 
 # The following define makes your compiler emit warnings if you use
 # any Qt feature that has been marked deprecated (the exact warnings
@@ -15,14 +15,46 @@ DEFINES += QT_DEPRECATED_WARNINGS
 # You can also select to disable deprecated APIs only up to a certain version of Qt.
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
+# Trace records below this level are compiled out (0 - Debug ... 3 - Error).
+#DEFINES += TRACING_MIN_LEVEL=2
+
+include(protocol/protocol.pri)
+
 SOURCES += \
+    capture-file.cpp \
+    connection-controller.cpp \
+    device-discovery.cpp \
     device-driver.cpp \
+    device-fleet.cpp \
+    device-stats.cpp \
+    frame-parser.cpp \
     main.cpp \
-    mainwindow.cpp
+    mainwindow.cpp \
+    port-cache.cpp \
+    port-watcher.cpp \
+    stats-panel.cpp \
+    trace-model.cpp
 
 HEADERS += \
+    capture-file.h \
+    connection-controller.h \
+    device-commands.h \
+    device-discovery.h \
     device-driver.h \
-    mainwindow.h
+    device-fleet.h \
+    device-stats.h \
+    field-cache.h \
+    frame-parser.h \
+    latency-histogram.h \
+    mainwindow.h \
+    port-cache.h \
+    port-watcher.h \
+    ring-buffer.h \
+    rtt-estimator.h \
+    seqlock.h \
+    stats-panel.h \
+    trace-model.h \
+    tracing.h
 
 FORMS += \
     about.ui \
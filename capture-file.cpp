@@ -0,0 +1,212 @@
+#include "capture-file.h"
+#include <cstring>
+
+namespace {
+const size_t kMaxPending = 8 * 1024 * 1024; // предел буфера, если диск не успевает
+}
+
+namespace Capture {
+
+Reader::Reader()
+	: _data(nullptr)
+	, _size(0)
+	, _offset(0)
+	, _truncated(false)
+	, _header({})
+{
+}
+
+bool Reader::Open(const uint8_t* data, size_t size)
+{
+	_data = nullptr;
+	_size = 0;
+	_offset = 0;
+	_truncated = false;
+
+	if (!data || size < sizeof(FileHeader)) {
+		return false;
+	}
+	std::memcpy(&_header, data, sizeof(FileHeader));
+	if (std::memcmp(_header.magic, kMagic, sizeof(kMagic)) != 0
+			|| _header.version != kVersion)
+	{
+		return false;
+	}
+
+	_data = data;
+	_size = size;
+	_offset = sizeof(FileHeader);
+	return true;
+}
+
+const FileHeader& Reader::Header() const
+{
+	return _header;
+}
+
+bool Reader::Next(Record& record)
+{
+	if (!_data || _offset == _size) {
+		return false;
+	}
+
+	RecordHeader header;
+	if (_size - _offset < sizeof(RecordHeader)) {
+		_truncated = true;
+		return false;
+	}
+	std::memcpy(&header, _data + _offset, sizeof(RecordHeader));
+	if (_size - _offset - sizeof(RecordHeader) < header.size) {
+		_truncated = true;
+		return false;
+	}
+
+	record.timestamp_ns = header.timestamp_ns;
+	record.port = header.port;
+	record.type = static_cast<RecordType>(header.type);
+	record.data = _data + _offset + sizeof(RecordHeader);
+	record.size = header.size;
+
+	_offset += sizeof(RecordHeader) + header.size;
+	return true;
+}
+
+bool Reader::IsTruncated() const
+{
+	return _truncated;
+}
+
+}
+
+CaptureWriter::CaptureWriter()
+	: _file(nullptr)
+	, _open(false)
+	, _stop(false)
+	, _next_port(0)
+	, _dropped(0)
+{
+}
+
+CaptureWriter::~CaptureWriter()
+{
+	Close();
+}
+
+bool CaptureWriter::Open(const std::string& path)
+{
+	Close();
+
+	_file = std::fopen(path.c_str(), "wb");
+	if (!_file) {
+		return false;
+	}
+
+	Capture::FileHeader header = {};
+	std::memcpy(header.magic, Capture::kMagic, sizeof(Capture::kMagic));
+	header.version = Capture::kVersion;
+	header.start_time_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::system_clock::now().time_since_epoch()).count();
+	if (std::fwrite(&header, sizeof(header), 1, _file) != 1) {
+		std::fclose(_file);
+		_file = nullptr;
+		return false;
+	}
+
+	_start = std::chrono::steady_clock::now();
+	_stop = false;
+	_next_port = 0;
+	_dropped = 0;
+	_thread = std::thread(&CaptureWriter::Run, this);
+	_open = true;
+	return true;
+}
+
+void CaptureWriter::Close()
+{
+	if (!_thread.joinable()) {
+		return;
+	}
+
+	_open = false;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_stop = true;
+	}
+	_wake.notify_one();
+	_thread.join();
+
+	std::fclose(_file);
+	_file = nullptr;
+	_pending.clear();
+}
+
+bool CaptureWriter::IsOpen() const
+{
+	return _open;
+}
+
+uint16_t CaptureWriter::RegisterPort(const std::string& name)
+{
+	uint16_t port = 0;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		port = _next_port++;
+	}
+	Record(port, Capture::PortName, name.data(), name.size());
+	return port;
+}
+
+void CaptureWriter::Record(uint16_t port, Capture::RecordType type, const void* data, size_t size)
+{
+	if (!_open) {
+		return;
+	}
+
+	Capture::RecordHeader header = {};
+	header.size = static_cast<uint32_t>(size);
+	header.port = port;
+	header.type = type;
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		// Отметка под замком: порядок записей в файле совпадает с порядком
+		// времени, даже если Record вызывают несколько потоков
+		header.timestamp_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+					std::chrono::steady_clock::now() - _start).count();
+		if (_pending.size() + sizeof(header) + size > kMaxPending) {
+			_dropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		const auto bytes = reinterpret_cast<const char*>(&header);
+		_pending.insert(_pending.end(), bytes, bytes + sizeof(header));
+		_pending.insert(_pending.end(),
+						static_cast<const char*>(data),
+						static_cast<const char*>(data) + size);
+	}
+	_wake.notify_one();
+}
+
+uint64_t CaptureWriter::Dropped() const
+{
+	return _dropped.load(std::memory_order_relaxed);
+}
+
+void CaptureWriter::Run()
+{
+	std::vector<char> chunk;
+	for (;;) {
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_wake.wait(lock, [this]() { return _stop || !_pending.empty(); });
+			if (_pending.empty() && _stop) {
+				return;
+			}
+			chunk.swap(_pending);
+		}
+
+		// Сбрасывается сразу: запись должна пережить аварийное завершение
+		std::fwrite(chunk.data(), 1, chunk.size(), _file);
+		std::fflush(_file);
+		chunk.clear();
+	}
+}
@@ -0,0 +1,117 @@
+#ifndef CAPTUREFILE_H
+#define CAPTUREFILE_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Двоичная запись обмена с портом. Файл: заголовок FileHeader, затем
+// записи RecordHeader + size байт данных. Порядок байт - как у машины,
+// записавшей файл. Не зависит от Qt, чтобы файлы читались любым инструментом.
+namespace Capture {
+
+constexpr char kMagic[8] = {'A', 'R', 'C', 'A', 'P', 'T', 'R', 'C'};
+constexpr uint32_t kVersion = 1;
+
+enum RecordType : uint8_t {
+	Transmit = 0, // байты, отданные в порт
+	Receive = 1, // кусок, прочитанный из порта
+	PortName = 2 // имя порта для номера port, данные - имя в UTF-8
+};
+
+struct FileHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t reserved;
+	int64_t start_time_ns; // системное время начала записи (нс с начала эпохи)
+};
+
+struct RecordHeader {
+	uint64_t timestamp_ns; // монотонное время от начала записи
+	uint32_t size;
+	uint16_t port;
+	uint8_t type;
+	uint8_t reserved;
+};
+
+static_assert(sizeof(FileHeader) == 24, "unexpected FileHeader layout");
+static_assert(sizeof(RecordHeader) == 16, "unexpected RecordHeader layout");
+
+struct Record {
+	uint64_t timestamp_ns;
+	uint16_t port;
+	RecordType type;
+	const uint8_t* data; // указывает внутрь разбираемого буфера
+	uint32_t size;
+};
+
+// Последовательное чтение записей из буфера (например, отображённого файла)
+class Reader
+{
+public:
+	Reader();
+
+	// false - не файл записи или неизвестная версия
+	bool Open(const uint8_t* data, size_t size);
+	const FileHeader& Header() const;
+
+	// false - записи кончились или последняя запись оборвана
+	bool Next(Record&);
+	bool IsTruncated() const;
+
+private:
+	const uint8_t* _data;
+	size_t _size;
+	size_t _offset;
+	bool _truncated;
+	FileHeader _header;
+};
+
+}
+
+// Запись обмена в файл фоновым потоком. Record() только копирует данные
+// в буфер, поэтому потоки драйверов не ждут диск.
+class CaptureWriter
+{
+public:
+	CaptureWriter();
+	~CaptureWriter();
+
+	CaptureWriter(const CaptureWriter&) = delete;
+	CaptureWriter& operator=(const CaptureWriter&) = delete;
+
+	bool Open(const std::string& path);
+	void Close();
+	bool IsOpen() const;
+
+	// Номер порта для последующих записей, имя сохраняется в файл
+	uint16_t RegisterPort(const std::string& name);
+	void Record(uint16_t port, Capture::RecordType, const void* data, size_t size);
+
+	// Записи, отброшенные из-за переполнения буфера
+	uint64_t Dropped() const;
+
+private:
+	std::mutex _mutex;
+	std::condition_variable _wake;
+	std::vector<char> _pending; // записи, ещё не отданные на диск
+	std::thread _thread;
+	std::FILE* _file;
+	std::chrono::steady_clock::time_point _start;
+	std::atomic<bool> _open;
+	bool _stop;
+	uint16_t _next_port;
+	std::atomic<uint64_t> _dropped;
+
+private:
+	void Run();
+};
+
+#endif // CAPTUREFILE_H
@@ -0,0 +1,282 @@
+#include "connection-controller.h"
+#include <QTimer>
+
+namespace {
+const unsigned int kMaxRetryNumber = 2;
+const int kRetryDelay = 200; // пауза перед повторным поиском (мс)
+const int kPollingInterval = 1000; // период опроса счетчиков (мс)
+// Кэш драйвера избавляет от перечитывания только что записанного;
+// нажатие "подключить" всегда читает устройство
+const int kCountersFreshness = 1000; // счетчики растут, пока устройство работает (мс)
+const int kParametersFreshness = 10000; // параметры могут сменить с панели устройства (мс)
+}
+
+ConnectionController::ConnectionController(DeviceDriver* driver, QObject *parent)
+	: QObject(parent)
+	, _driver(driver)
+	, _state(State::Initial)
+	, _refresh_pending(false)
+	, _polling(false)
+	, _retry_number(0)
+	, _retry_timer(new QTimer(this))
+	, _counters({})
+	, _parameters({})
+	, _characteristics({})
+{
+	qRegisterMetaType<ConnectionController::State>("ConnectionController::State");
+
+	_retry_timer->setSingleShot(true);
+	_retry_timer->setInterval(kRetryDelay);
+	connect(_retry_timer, &QTimer::timeout, this, &ConnectionController::FindDevice);
+
+	connect(this, &ConnectionController::FindDevice, _driver, &DeviceDriver::FindDevice);
+	connect(this, &ConnectionController::ReadSnapshot, _driver, &DeviceDriver::ReadSnapshot);
+	connect(this, &ConnectionController::WriteDeviceCounters, _driver, &DeviceDriver::WriteCounters);
+	connect(this, &ConnectionController::WriteDeviceParameters, _driver, &DeviceDriver::WriteParameters);
+	connect(this, &ConnectionController::LaunchDeviceSingleCycle, _driver, &DeviceDriver::LaunchSingleCycle);
+	connect(this, &ConnectionController::StartDevicePolling, _driver, &DeviceDriver::StartPolling);
+	connect(this, &ConnectionController::StopDevicePolling, _driver, &DeviceDriver::StopPolling);
+	connect(this, &ConnectionController::SetDeviceCacheFreshness, _driver, &DeviceDriver::SetCacheFreshness);
+	connect(this, &ConnectionController::InvalidateDeviceCache, _driver, &DeviceDriver::InvalidateCache);
+
+	connect(_driver, &DeviceDriver::Event, this, &ConnectionController::HandleEvent);
+
+	emit SetDeviceCacheFreshness(kCountersFreshness, kParametersFreshness);
+}
+
+ConnectionController::State ConnectionController::CurrentState() const
+{
+	return _state;
+}
+
+bool ConnectionController::IsRefreshPending() const
+{
+	return _refresh_pending;
+}
+
+bool ConnectionController::IsPolling() const
+{
+	return _polling;
+}
+
+DeviceDriver::Counters ConnectionController::GetCounters() const
+{
+	return _counters;
+}
+
+DeviceDriver::Parameters ConnectionController::GetParameters() const
+{
+	return _parameters;
+}
+
+DeviceDriver::MeasuredCharacteristics ConnectionController::GetCharacteristics() const
+{
+	return _characteristics;
+}
+
+void ConnectionController::Connect()
+{
+	if (!_driver->IsConnected() || _state == State::Initial) {
+		_retry_number = 0;
+		SetState(State::Connect);
+		emit Progress("Поиск устройства...");
+		emit FindDevice();
+		return;
+	}
+
+	// Явный запрос пользователя: значения читаются из устройства, не из кэша
+	if (_state == State::Ready) {
+		emit InvalidateDeviceCache();
+	}
+	Refresh();
+}
+
+void ConnectionController::Refresh()
+{
+	if (_state != State::Ready) {
+		return;
+	}
+
+	_refresh_pending = false;
+	SetState(State::ReadSnapshot);
+	emit Progress("Чтение данных...");
+	emit ReadSnapshot();
+}
+
+void ConnectionController::WriteCounters(const DeviceDriver::Counters counters)
+{
+	SetState(State::WriteCounters);
+	emit Progress("Передача счетчиков...");
+	emit WriteDeviceCounters(counters);
+}
+
+void ConnectionController::WriteParameters(const DeviceDriver::Parameters parameters)
+{
+	SetState(State::WriteParameters);
+	emit Progress("Передача параметров...");
+	emit WriteDeviceParameters(parameters);
+}
+
+void ConnectionController::LaunchSingleCycle()
+{
+	SetState(State::LaunchSingleCycle);
+	emit Progress("Однократный пуск цикла...");
+	emit LaunchDeviceSingleCycle();
+}
+
+void ConnectionController::SetPolling(bool enabled)
+{
+	_polling = enabled && _state != State::Initial && _state != State::Connect;
+	if (_polling) {
+		emit StartDevicePolling(kPollingInterval, DeviceDriver::TelemetryCounters);
+	} else {
+		emit StopDevicePolling();
+	}
+}
+
+void ConnectionController::SetState(State state)
+{
+	// Без подключения опрашивать нечего: драйвер останавливает опрос при закрытии порта
+	if (state == State::Initial || state == State::Connect) {
+		_polling = false;
+	}
+
+	if (_state != state) {
+		_state = state;
+		emit StateChanged(_state);
+	}
+}
+
+void ConnectionController::HandleEvent(DeviceDriver::EventCode event)
+{
+	if (event == DeviceDriver::EventCode::TelemetrySampled) {
+		return;
+	}
+
+	// Ошибка фонового опроса означает потерю связи: драйвер уже закрыл порт
+	if (event == DeviceDriver::EventCode::DeviceDisconnected
+			|| event == DeviceDriver::EventCode::TelemetryError)
+	{
+		_retry_timer->stop();
+		_retry_number = 0;
+		SetState(State::Initial);
+		emit Notice("Подключение прервано :(");
+		return;
+	}
+
+	switch (_state) {
+	case State::Initial: {
+		// Устройство нашлось само, когда адаптер вставили в USB
+		if (event == DeviceDriver::EventCode::DeviceFound)
+		{
+			SetState(State::ReadSnapshot);
+			emit Progress("Чтение данных...");
+			emit ReadSnapshot();
+		}
+	}
+		break;
+
+
+	case State::Connect: {
+		if (event == DeviceDriver::EventCode::DeviceFound)
+		{
+			_retry_number = 0;
+			SetState(State::ReadSnapshot);
+			emit Progress("Чтение данных...");
+			emit ReadSnapshot();
+		}
+		else if (event == DeviceDriver::EventCode::DeviceNotFound)
+		{
+			Retry("Устройство не найдено :(", "EventCode::DeviceNotFound");
+		}
+	}
+		break;
+
+
+	case State::ReadSnapshot: {
+		if (event == DeviceDriver::EventCode::ReadSnapshotSuccess)
+		{
+			_retry_number = 0;
+			_counters = _driver->GetCounters();
+			_parameters = _driver->GetParameters();
+			SetState(State::Ready);
+			emit SnapshotUpdated();
+		}
+		else if (event == DeviceDriver::EventCode::ReadSnapshotError)
+		{
+			Retry("Ошибка чтения данных устройства :(", "EventCode::ReadSnapshotError");
+		}
+	}
+		break;
+
+
+	case State::WriteCounters: {
+		if (event == DeviceDriver::EventCode::WriteCountersSuccess)
+		{
+			_refresh_pending = true;
+			SetState(State::Ready);
+			emit Notice("Успешно!");
+		}
+		else if (event == DeviceDriver::EventCode::WriteCountersError)
+		{
+			SetState(State::Ready);
+			emit Notice("Ошибка передачи счётчиков :(");
+			TRACE(State, Error, "EventCode::WriteCountersError");
+		}
+	}
+		break;
+
+
+	case State::WriteParameters: {
+		if (event == DeviceDriver::EventCode::WriteParametersSuccess)
+		{
+			_refresh_pending = true;
+			SetState(State::Ready);
+			emit Notice("Успешно!");
+		}
+		else if (event == DeviceDriver::EventCode::WriteParametersError)
+		{
+			SetState(State::Ready);
+			emit Notice("Ошибка передачи параметров :(");
+			TRACE(State, Error, "EventCode::WriteParametersError");
+		}
+	}
+		break;
+
+
+	case State::LaunchSingleCycle: {
+		if (event == DeviceDriver::EventCode::LaunchSingleCycleSuccess)
+		{
+			_characteristics = _driver->GetCharacteristics();
+			SetState(State::Ready);
+			emit CharacteristicsUpdated();
+		}
+		else if (event == DeviceDriver::EventCode::LaunchSingleCycleError)
+		{
+			SetState(State::Ready);
+			emit Notice("Ошибка однократного запуска цикла :(");
+			TRACE(State, Error, "EventCode::LaunchSingleCycleError");
+		}
+	}
+		break;
+
+
+	case State::Ready: break;
+	}
+}
+
+void ConnectionController::Retry(const QString& error_message, const char* error_trace)
+{
+	if (_retry_number < kMaxRetryNumber) {
+		++_retry_number;
+		TRACE(State, Warning, QString("Retry connect №") + QString::number(_retry_number));
+		SetState(State::Connect);
+		emit Progress("Попытка переподключения...");
+		_retry_timer->start();
+	} else {
+		_retry_number = 0;
+		SetState(State::Initial);
+		emit Notice(error_message);
+		TRACE(State, Error, error_trace);
+	}
+}
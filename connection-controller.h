@@ -0,0 +1,90 @@
+#ifndef CONNECTIONCONTROLLER_H
+#define CONNECTIONCONTROLLER_H
+
+#include "device-driver.h"
+
+#include <QObject>
+
+class QTimer;
+
+// Последовательность обмена с устройством (поиск, чтение, запись, пуск цикла)
+// без привязки к виджетам. Окно только наблюдает за состоянием и сигналами.
+class ConnectionController : public QObject
+{
+	Q_OBJECT
+
+public:
+	enum class State {
+		Initial,
+		Connect,
+		Ready,
+		ReadSnapshot,
+		WriteCounters,
+		WriteParameters,
+		LaunchSingleCycle
+	};
+
+public:
+	explicit ConnectionController(DeviceDriver* driver, QObject *parent = nullptr);
+
+	State CurrentState() const;
+	// После успешной записи данные устройства нужно перечитать
+	bool IsRefreshPending() const;
+	bool IsPolling() const;
+
+	DeviceDriver::Counters GetCounters() const;
+	DeviceDriver::Parameters GetParameters() const;
+	DeviceDriver::MeasuredCharacteristics GetCharacteristics() const;
+
+public slots:
+	// Поиск устройства либо обновление данных уже подключенного
+	void Connect();
+	void Refresh();
+
+	void WriteCounters(const DeviceDriver::Counters);
+	void WriteParameters(const DeviceDriver::Parameters);
+	void LaunchSingleCycle();
+
+	// Периодическое чтение счетчиков в фоне (отсчёты - DeviceDriver::DrainTelemetry)
+	void SetPolling(bool);
+
+signals:
+	void StateChanged(ConnectionController::State);
+	void Progress(const QString&); // идёт обмен
+	void Notice(const QString&); // итог операции
+	void SnapshotUpdated();
+	void CharacteristicsUpdated();
+	void Trace(const QString&);
+
+	// Команды драйверу
+	void FindDevice();
+	void ReadSnapshot();
+	void WriteDeviceCounters(const DeviceDriver::Counters);
+	void WriteDeviceParameters(const DeviceDriver::Parameters);
+	void LaunchDeviceSingleCycle();
+	void StartDevicePolling(int interval_ms, int sources);
+	void StopDevicePolling();
+	void SetDeviceCacheFreshness(int counters_ms, int parameters_ms);
+	void InvalidateDeviceCache();
+
+private:
+	DeviceDriver* _driver;
+	State _state;
+	bool _refresh_pending;
+	bool _polling;
+	unsigned int _retry_number;
+	QTimer* _retry_timer;
+
+	DeviceDriver::Counters _counters;
+	DeviceDriver::Parameters _parameters;
+	DeviceDriver::MeasuredCharacteristics _characteristics;
+
+private:
+	void SetState(State);
+	void HandleEvent(DeviceDriver::EventCode);
+	void Retry(const QString& error_message, const char* error_trace);
+};
+
+Q_DECLARE_METATYPE(ConnectionController::State)
+
+#endif // CONNECTIONCONTROLLER_H
@@ -0,0 +1,93 @@
+#ifndef DEVICECOMMANDS_H
+#define DEVICECOMMANDS_H
+
+#include "device-driver.h"
+#include "frame-codec.h"
+
+#include <QByteArray>
+
+#include <type_traits>
+
+// Команды протокола как типы: код, данные запроса, данные ответа и события
+// драйвера об успехе и ошибке. Кадры и кодеки - из библиотеки protocol/,
+// здесь только привязка к QByteArray и событиям DeviceDriver; новая
+// команда - одна строка typedef в Commands.
+namespace Commands {
+
+typedef DeviceDriver::EventCode Event;
+using Protocol::Opcode;
+using Protocol::NoPayload;
+
+template <Opcode Code,
+		  class RequestData,
+		  class ResponseData,
+		  DeviceDriver::EventCode Success,
+		  DeviceDriver::EventCode Error>
+struct Command {
+	static_assert(Success != Error, "success and error events must differ");
+
+	typedef RequestData Request;
+	typedef ResponseData Response;
+
+	static constexpr Opcode kCode = Code;
+	static constexpr DeviceDriver::EventCode kSuccess = Success;
+	static constexpr DeviceDriver::EventCode kError = Error;
+
+	// Готовый кадр без копирования, только для команд без данных
+	static QByteArray Frame()
+	{
+		static_assert(std::is_same<Request, NoPayload>::value, "command takes request data");
+		return QByteArray::fromRawData(Protocol::FixedFrame<Code>::kRequest,
+									   sizeof(Protocol::FixedFrame<Code>::kRequest));
+	}
+
+	// Кадр с данными: одно выделение памяти под кадр целиком
+	static QByteArray Frame(const Request& request)
+	{
+		QByteArray result(static_cast<int>(Protocol::FrameSize(Protocol::HexSize<Request>())), Qt::Uninitialized);
+		Protocol::BuildRequest(Code, request, result.data());
+		return result;
+	}
+
+	static QByteArray Reply()
+	{
+		return QByteArray::fromRawData(Protocol::FixedFrame<Code>::kReply,
+									   sizeof(Protocol::FixedFrame<Code>::kReply));
+	}
+
+	// false - неверная длина или не-hex данные, response не меняется.
+	// Данные ответа на запись не проверяются: протокол их не описывает
+	static bool Parse(const char* data, size_t size, Response* response)
+	{
+		if constexpr (std::is_same<Response, NoPayload>::value) {
+			return true;
+		} else {
+			return Protocol::Decode(data, size, response);
+		}
+	}
+};
+
+typedef Command<Opcode::ReadCounters, NoPayload, DeviceDriver::Counters,
+				Event::ReadCountersSuccess, Event::ReadCountersError> ReadCounters;
+typedef Command<Opcode::WriteCounters, DeviceDriver::Counters, NoPayload,
+				Event::WriteCountersSuccess, Event::WriteCountersError> WriteCounters;
+typedef Command<Opcode::ReadParameters, NoPayload, DeviceDriver::Parameters,
+				Event::ReadParametersSuccess, Event::ReadParametersError> ReadParameters;
+typedef Command<Opcode::WriteParameters, DeviceDriver::Parameters, NoPayload,
+				Event::WriteParametersSuccess, Event::WriteParametersError> WriteParameters;
+typedef Command<Opcode::SingleCycle, NoPayload, DeviceDriver::MeasuredCharacteristics,
+				Event::LaunchSingleCycleSuccess, Event::LaunchSingleCycleError> LaunchSingleCycle;
+
+// Те же запросы в составе пакета чтения и опроса телеметрии
+typedef Command<Opcode::ReadCounters, NoPayload, DeviceDriver::Counters,
+				Event::ReadSnapshotSuccess, Event::ReadSnapshotError> SnapshotCounters;
+typedef Command<Opcode::ReadParameters, NoPayload, DeviceDriver::Parameters,
+				Event::ReadSnapshotSuccess, Event::ReadSnapshotError> SnapshotParameters;
+typedef Command<Opcode::ReadCounters, NoPayload, DeviceDriver::Counters,
+				Event::TelemetrySampled, Event::TelemetryError> TelemetryCounters;
+typedef Command<Opcode::SingleCycle, NoPayload, DeviceDriver::MeasuredCharacteristics,
+				Event::TelemetrySampled, Event::TelemetryError> TelemetrySingleCycle;
+
+}
+
+#endif // DEVICECOMMANDS_H
@@ -0,0 +1,278 @@
+#include "device-discovery.h"
+#include "port-cache.h"
+#include <QSerialPort>
+#include <QTimer>
+#include <algorithm>
+#include <functional>
+
+namespace {
+const int kMinStepTimeout = 100; // мс на одну скорость
+const qint32 kDefaultBaudRate = QSerialPort::Baud115200; // скорость протокола по умолчанию
+}
+
+DeviceDiscovery::DeviceDiscovery(QObject *parent)
+	: QObject(parent)
+	, _baud_rates({kDefaultBaudRate})
+	, _verify_count(0)
+	, _step_timeout(kMinStepTimeout)
+	, _timer(new QTimer(this))
+{
+	_timer->setSingleShot(true);
+	connect(_timer, &QTimer::timeout, this, [this]() { Finish(nullptr); });
+}
+
+DeviceDiscovery::~DeviceDiscovery()
+{
+	Cancel();
+}
+
+bool DeviceDiscovery::IsRunning() const
+{
+	return _timer->isActive();
+}
+
+QList<QSerialPortInfo> DeviceDiscovery::AvailablePorts()
+{
+	return QSerialPortInfo::availablePorts();
+}
+
+QStringList DeviceDiscovery::ExtraPorts()
+{
+	return qEnvironmentVariable("ARCHIPELAGO_EXTRA_PORTS").split(':', Qt::SkipEmptyParts);
+}
+
+QStringList DeviceDiscovery::AvailablePortNames()
+{
+	QStringList names;
+	const auto ports = AvailablePorts();
+	for (const auto& info : ports) {
+		names.append(info.portName());
+	}
+	names.append(ExtraPorts());
+	return names;
+}
+
+void DeviceDiscovery::SetBaudRates(const QList<qint32>& baud_rates)
+{
+	_baud_rates = baud_rates;
+	if (_baud_rates.isEmpty()) {
+		_baud_rates.append(kDefaultBaudRate);
+	}
+	// Стандартная скорость первой: на ней работает большинство устройств,
+	// остальные - от быстрой к медленной
+	std::sort(_baud_rates.begin(), _baud_rates.end(), std::greater<qint32>());
+	if (_baud_rates.removeOne(kDefaultBaudRate)) {
+		_baud_rates.prepend(kDefaultBaudRate);
+	}
+}
+
+void DeviceDiscovery::SetVerification(const QByteArray& request, const QByteArray& reply, int count)
+{
+	_verify_request = request;
+	_verify_reply = reply;
+	_verify_count = count;
+}
+
+void DeviceDiscovery::Start(const QStringList& ports,
+							const QByteArray& request,
+							const QByteArray& reply,
+							int timeout_ms)
+{
+	Cancel();
+	_request = request;
+	_reply = reply;
+	_step_timeout = qMax(kMinStepTimeout, timeout_ms / _baud_rates.size());
+
+	for (const auto& port_name : ports) {
+		OpenProbe(port_name);
+	}
+
+	if (_probes.isEmpty()) {
+		emit NotFound();
+		return;
+	}
+
+	// Каждый порт сам заканчивает перебор по таймаутам шагов; общий таймаут -
+	// их сумма и запас на открытие портов, чтобы не обрезать последний шаг
+	const int deadline = IsNegotiating()
+			? _step_timeout * _baud_rates.size() + kMinStepTimeout
+			: timeout_ms;
+	_timer->start(deadline);
+}
+
+void DeviceDiscovery::Cancel()
+{
+	_timer->stop();
+	const auto ports = _probes.keys();
+	for (auto port : ports) {
+		DropProbe(port);
+	}
+}
+
+bool DeviceDiscovery::IsNegotiating() const
+{
+	return _baud_rates.size() > 1;
+}
+
+bool DeviceDiscovery::OpenProbe(const QString& port_name)
+{
+	// Запомненная скорость проверяется первой
+	Probe probe = {FrameParser(), _baud_rates, 0, false, 0, nullptr};
+	const qint32 remembered = PortCache::BaudRate(QSerialPortInfo(port_name));
+	if (IsNegotiating() && probe.rates.removeOne(remembered)) {
+		probe.rates.prepend(remembered);
+	}
+
+	// Открытие по имени: путь вне списка Qt через QSerialPortInfo не открыть
+	auto port = new QSerialPort(this);
+	port->setPortName(port_name);
+	port->setBaudRate(probe.rates.first());
+	port->setDataBits(QSerialPort::Data8);
+	port->setParity(QSerialPort::Parity::NoParity);
+	port->setStopBits(QSerialPort::StopBits::OneStop);
+	port->setFlowControl(QSerialPort::FlowControl::NoFlowControl);
+
+	TRACE(Discovery, Debug, QString("Try open -> ") + port_name);
+	if (!port->open(QIODevice::ReadWrite)) {
+		TRACE(Discovery, Debug, "error : " + port_name);
+		port->deleteLater();
+		return false;
+	}
+
+	probe.step_timer = new QTimer(port);
+	probe.step_timer->setSingleShot(true);
+	connect(probe.step_timer, &QTimer::timeout, this, [this, port]() { NextStep(port); });
+	_probes.insert(port, probe);
+
+	connect(port, &QSerialPort::readyRead, this, [this, port]() { ReadProbe(port); });
+	connect(port, &QSerialPort::errorOccurred, this,
+			[this, port](QSerialPort::SerialPortError error) {
+		if (error != QSerialPort::NoError && _probes.contains(port)) {
+			TRACE(Discovery, Debug, "error : " + port->portName() + " " + port->errorString());
+			DropProbe(port);
+			if (_probes.isEmpty() && IsRunning()) {
+				Finish(nullptr);
+			}
+		}
+	});
+
+	StartStep(port);
+	return true;
+}
+
+void DeviceDiscovery::StartStep(QSerialPort* port)
+{
+	auto& probe = _probes.find(port).value();
+	const qint32 baud_rate = probe.rates.at(probe.rate_index);
+
+	// Остатки ответов на прошлой скорости не должны попасть в проверку
+	probe.parser.Reset();
+	port->clear();
+	if (!port->setBaudRate(baud_rate)) {
+		NextStep(port);
+		return;
+	}
+
+	probe.ping_ok = false;
+	probe.expected = IsNegotiating() ? _verify_count : 0;
+
+	QByteArray burst = _request;
+	for (int i = 0; i < probe.expected; ++i) {
+		burst += _verify_request;
+	}
+
+	if (IsNegotiating()) {
+		TRACE(Discovery, Debug, port->portName() + " @ " + QString::number(baud_rate));
+		probe.step_timer->start(_step_timeout);
+	}
+	TRACE_FRAME(Out, burst);
+	port->write(burst);
+}
+
+void DeviceDiscovery::NextStep(QSerialPort* port)
+{
+	auto it = _probes.find(port);
+	if (it == _probes.end()) {
+		return;
+	}
+
+	if (++it->rate_index < it->rates.size()) {
+		StartStep(port);
+		return;
+	}
+
+	TRACE(Discovery, Debug, "error : " + port->portName());
+	DropProbe(port);
+	if (_probes.isEmpty() && IsRunning()) {
+		Finish(nullptr);
+	}
+}
+
+void DeviceDiscovery::ReadProbe(QSerialPort* port)
+{
+	auto it = _probes.find(port);
+	if (it == _probes.end()) {
+		return;
+	}
+
+	Probe& probe = it.value();
+	probe.parser.Append(port->readAll());
+
+	while (probe.parser.HasFrame()) {
+		const auto frame = probe.parser.TakeFrame();
+		TRACE_FRAME(In, frame.raw);
+
+		if (frame.raw.startsWith(_reply)) {
+			probe.ping_ok = true;
+		} else if (probe.expected > 0 && frame.raw.startsWith(_verify_reply)) {
+			// Одна ошибка CRC - скорость ненадёжна, переходим к следующей
+			if (!frame.crc_ok) {
+				NextStep(port);
+				return;
+			}
+			--probe.expected;
+		}
+
+		if (probe.ping_ok && probe.expected == 0) {
+			Finish(port);
+			return;
+		}
+	}
+}
+
+void DeviceDiscovery::DropProbe(QSerialPort* port)
+{
+	const auto probe = _probes.take(port);
+	if (probe.step_timer) {
+		probe.step_timer->stop();
+	}
+	port->disconnect(this);
+	if (port->isOpen()) {
+		port->close();
+	}
+	port->deleteLater();
+}
+
+void DeviceDiscovery::Finish(QSerialPort* winner)
+{
+	_timer->stop();
+
+	if (winner) {
+		const auto probe = _probes.take(winner);
+		delete probe.step_timer;
+		winner->disconnect(this);
+		TRACE(Discovery, Info, "ok : " + winner->portName() + " @ " + QString::number(winner->baudRate()));
+	}
+
+	const auto ports = _probes.keys();
+	for (auto port : ports) {
+		TRACE(Discovery, Debug, "error : " + port->portName());
+		DropProbe(port);
+	}
+
+	if (winner) {
+		emit Found(winner);
+	} else {
+		emit NotFound();
+	}
+}
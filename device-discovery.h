@@ -0,0 +1,92 @@
+#ifndef DEVICEDISCOVERY_H
+#define DEVICEDISCOVERY_H
+
+#include <QSerialPortInfo>
+#include <QObject>
+#include <QHash>
+#include <QStringList>
+
+#include "frame-parser.h"
+#include "tracing.h"
+
+class QSerialPort;
+class QTimer;
+
+// Параллельный поиск устройства: пинг отправляется во все порты сразу,
+// побеждает первый корректный ответ, остальные порты закрываются.
+// Время поиска ограничено одним таймаутом, а не их суммой по портам.
+// Если задано несколько скоростей, каждый порт перебирает их и принимает
+// скорость только после пачки проверочных запросов с верной CRC. Первой
+// проверяется скорость из PortCache, затем 115200, затем остальные от
+// быстрой к медленной; timeout_ms делится между скоростями поровну.
+class DeviceDiscovery : public QObject
+{
+	Q_OBJECT
+
+public:
+	explicit DeviceDiscovery(QObject *parent = nullptr);
+	~DeviceDiscovery();
+
+	bool IsRunning() const;
+
+	// Порты системы
+	static QList<QSerialPortInfo> AvailablePorts();
+	// Пути из ARCHIPELAGO_EXTRA_PORTS (через ':'), например псевдотерминалы
+	// симулятора. Qt их не перечисляет, QSerialPortInfo для них пустой,
+	// поэтому такие порты передаются и открываются по пути
+	static QStringList ExtraPorts();
+	// Имена портов системы и пути ExtraPorts() в виде, который принимает Start
+	static QStringList AvailablePortNames();
+
+	// Скорости для перебора; одна скорость - прежний поиск по одному пингу
+	void SetBaudRates(const QList<qint32>&);
+	// Проверочный запрос с CRC, отправляемый count раз вместе с пингом
+	void SetVerification(const QByteArray& request, const QByteArray& reply, int count);
+
+public slots:
+	// ports - имена портов или пути к ним
+	void Start(const QStringList& ports,
+			   const QByteArray& request,
+			   const QByteArray& reply,
+			   int timeout_ms);
+	void Cancel();
+
+signals:
+	// Владение открытым портом передаётся получателю
+	void Found(QSerialPort*);
+	void NotFound();
+	void Trace(const QString&);
+	// Кадр обмена без форматирования, см. Tracing::Io
+	void TraceFrame(Tracing::Direction, const QByteArray&);
+
+private:
+	struct Probe {
+		FrameParser parser;
+		QList<qint32> rates; // в порядке проверки
+		int rate_index;
+		bool ping_ok;
+		int expected; // проверочные ответы, которых ещё ждём
+		QTimer* step_timer;
+	};
+
+	QHash<QSerialPort*, Probe> _probes;
+	QByteArray _request;
+	QByteArray _reply;
+	QList<qint32> _baud_rates;
+	QByteArray _verify_request;
+	QByteArray _verify_reply;
+	int _verify_count;
+	int _step_timeout;
+	QTimer* _timer;
+
+private:
+	bool IsNegotiating() const;
+	bool OpenProbe(const QString& port_name);
+	void StartStep(QSerialPort*);
+	void NextStep(QSerialPort*);
+	void ReadProbe(QSerialPort*);
+	void DropProbe(QSerialPort*);
+	void Finish(QSerialPort*);
+};
+
+#endif // DEVICEDISCOVERY_H
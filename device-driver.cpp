@@ -1,21 +1,75 @@
 #include "device-driver.h"
+#include "device-commands.h"
+#include "device-discovery.h"
+#include "frame-parser.h"
+#include "port-cache.h"
+#include "port-watcher.h"
 #include <QThread>
-#include <QMutexLocker>
+#include <QTimer>
+#include <QTimerEvent>
+#include <QDateTime>
 #include <QSerialPortInfo>
+#include <QSettings>
 #include <QDebug>
+#include <algorithm>
 
-namespace Codes {
-const QByteArray kMasterSlave = "@";
-const QByteArray kSlaveMaster = "$";
-const QByteArray kCRLF = "\r\n";
-const QByteArray kPing = "55";
+namespace {
+const size_t kTelemetryCapacity = 16384;
+const int kBaudVerifyCount = 3; // проверочных чтений счетчиков на скорость
 
-const QByteArray kReadCounters = "20";
-const QByteArray kReadParameters = "30";
-const QByteArray kSingleCycle = "40";
+FieldCache<2>::Values CounterFields(const DeviceDriver::Counters& counters)
+{
+	return {counters.time, counters.cycles};
+}
+
+FieldCache<6>::Values ParameterFields(const DeviceDriver::Parameters& parameters)
+{
+	return {parameters.cpm, parameters.tp, parameters.tbc, parameters.tbtp, parameters.ct, parameters.tw};
+}
+
+// Скорости поиска: настройка serial/baud_rates или список по умолчанию.
+// Порядок перебора задаёт DeviceDiscovery: 115200 проверяется первой
+QList<qint32> DiscoveryBaudRates()
+{
+	static const QList<qint32> kDefaultBaudRates = {
+		115200, 921600, 460800, 230400, 57600, 38400, 19200, 9600
+	};
+
+	QList<qint32> result;
+	const auto values = QSettings().value("serial/baud_rates").toStringList();
+	for (const auto& value : values) {
+		const qint32 baud_rate = value.toInt();
+		if (baud_rate > 0) {
+			result.append(baud_rate);
+		}
+	}
+	return result.isEmpty() ? kDefaultBaudRates : result;
+}
 
-const QByteArray kWriteCounters = "2F";
-const QByteArray kWriteParameters = "3F";
+// На порту уже находили устройство
+bool IsCachedPort(const QList<PortCache::Entry>& cache, const QSerialPortInfo& port)
+{
+	return std::any_of(cache.begin(), cache.end(), [&port](const PortCache::Entry& entry) {
+		return PortCache::Matches(entry, port);
+	});
+}
+
+// Имя команды для статистики по коду запроса "@<код>..."
+QString CommandName(const QByteArray& request)
+{
+	Protocol::Opcode code;
+	if (Protocol::FrameCode(request.constData(), static_cast<size_t>(request.size()), &code)) {
+		switch (code) {
+		case Protocol::Opcode::ReadCounters: return "ReadCounters";
+		case Protocol::Opcode::WriteCounters: return "WriteCounters";
+		case Protocol::Opcode::ReadParameters: return "ReadParameters";
+		case Protocol::Opcode::WriteParameters: return "WriteParameters";
+		case Protocol::Opcode::SingleCycle: return "LaunchSingleCycle";
+		default: break;
+		}
+	}
+	return QString::fromLatin1(request.mid(1, Protocol::kCodeLength));
+}
 }
 
 DeviceDriver::DeviceDriver(QObject *parent)
@@ -25,10 +79,43 @@ DeviceDriver::DeviceDriver(QObject *parent)
 	, _parameters({})
 	, _characteristics({})
 	, _serial_port(nullptr)
+	, _discovery(new DeviceDiscovery(this))
+	, _port_watcher(nullptr)
+	, _pipelining(false)
+	, _last_batch(0)
+	, _poll_timer(new QTimer(this))
+	, _poll_sources(0)
+	, _poll_received(0)
+	, _poll_in_flight(false)
+	, _poll_sample({})
+	, _counters_freshness_ns(0)
+	, _parameters_freshness_ns(0)
+	, _telemetry(kTelemetryCapacity)
+	, _capture(nullptr)
+	, _capture_registered(nullptr)
+	, _capture_port(0)
+	, _last_cycle_ns(0)
 {
 	qRegisterMetaType<EventCode>("EventCode");
 	qRegisterMetaType<Counters>("Counters");
 	qRegisterMetaType<Parameters>("Parameters");
+	qRegisterMetaType<TelemetrySample>("TelemetrySample");
+	qRegisterMetaType<Tracing::Direction>("Tracing::Direction");
+
+	_clock.start();
+	connect(_poll_timer, &QTimer::timeout, this, &DeviceDriver::Poll);
+	Publish();
+
+	connect(_discovery, &DeviceDiscovery::Trace, this, &DeviceDriver::Trace);
+	connect(_discovery, &DeviceDiscovery::TraceFrame, this, &DeviceDriver::TraceFrame);
+	connect(_discovery, &DeviceDiscovery::Found, this, &DeviceDriver::AttachSerialPort);
+	connect(_discovery, &DeviceDiscovery::NotFound, this, [this]() {
+		if (!_discovery_stages.isEmpty()) {
+			StartDiscovery(_discovery_stages.takeFirst());
+			return;
+		}
+		emit Event(EventCode::DeviceNotFound);
+	});
 }
 
 DeviceDriver::~DeviceDriver()
@@ -37,196 +124,393 @@ DeviceDriver::~DeviceDriver()
 	_connected = false;
 }
 
-DeviceDriver::Counters DeviceDriver::GetCounters()
+DeviceDriver::DeviceSnapshot DeviceDriver::GetSnapshot() const
 {
-	QMutexLocker locker(&_data_mutex);
-	return _counters;
+	uint64_t generation = 0;
+	auto snapshot = _snapshot.Load(&generation);
+	snapshot.generation = generation;
+	return snapshot;
 }
 
-DeviceDriver::Parameters DeviceDriver::GetParameters()
+DeviceDriver::Counters DeviceDriver::GetCounters() const
 {
-	QMutexLocker locker(&_data_mutex);
-	return _parameters;
+	return _snapshot.Load().counters;
 }
 
-DeviceDriver::MeasuredCharacteristics DeviceDriver::GetCharacteristics()
+DeviceDriver::Parameters DeviceDriver::GetParameters() const
 {
-	QMutexLocker locker(&_data_mutex);
-	return _characteristics;
+	return _snapshot.Load().parameters;
 }
 
-bool DeviceDriver::IsConnected()
+DeviceDriver::MeasuredCharacteristics DeviceDriver::GetCharacteristics() const
+{
+	return _snapshot.Load().characteristics;
+}
+
+bool DeviceDriver::IsConnected() const
 {
 	return _connected;
 }
 
+int DeviceDriver::DrainTelemetry(QVector<TelemetrySample>& samples, int max)
+{
+	return static_cast<int>(_telemetry.Drain(samples, max < 0 ? static_cast<size_t>(-1) : max));
+}
+
+quint64 DeviceDriver::DroppedTelemetry() const
+{
+	return _telemetry.Dropped();
+}
+
+void DeviceDriver::SetCapture(CaptureWriter* capture)
+{
+	_capture.store(capture, std::memory_order_release);
+}
+
+DeviceStats::Report DeviceDriver::GetStats() const
+{
+	return _stats.Snapshot();
+}
+
+void DeviceDriver::ResetStats()
+{
+	_stats.Reset();
+}
+
 void DeviceDriver::FindDevice()
 {
-	const auto available_ports = QSerialPortInfo::availablePorts();
+	if (_discovery->IsRunning()) {
+		return;
+	}
 
-	emit Trace("Available devices:");
-	for (const auto& port : available_ports) {
-		emit Trace(port.portName() + " " + port.description());
+	const auto available_ports = _port_watcher ? _port_watcher->Ports() : DeviceDiscovery::AvailablePorts();
+	const auto extra_ports = DeviceDiscovery::ExtraPorts();
+
+	if (Tracing::IsEnabled(Tracing::Discovery, Tracing::Level::Debug)) {
+		emit Trace("Available devices:");
+		for (const auto& port : available_ports) {
+			emit Trace(port.portName() + " " + port.description());
+		}
+		for (const auto& path : extra_ports) {
+			emit Trace(path);
+		}
 	}
 
+	// Сначала порты, где устройство уже находили, затем адаптеры с известными
+	// USB VID/PID и явно заданные пути, и только потом все остальные
+	const auto cache = PortCache::Load();
+	QStringList cached;
+	QStringList known;
+	QStringList other;
 	for (const auto& port : available_ports) {
-
-		if (CheckSerialPort(port)) {
-			_connected = true;
-			break;
+		if (IsCachedPort(cache, port)) {
+			cached.append(port.portName());
+		} else if (PortCache::IsKnownUsbId(port)) {
+			known.append(port.portName());
+		} else {
+			other.append(port.portName());
 		}
 	}
+	known.append(extra_ports);
 
-	if (_connected) {
-		emit Event(EventCode::DeviceFound);
-	} else {
+	_discovery_stages.clear();
+	for (const auto& stage : {cached, known, other}) {
+		if (!stage.isEmpty()) {
+			_discovery_stages.append(stage);
+		}
+	}
+	if (_discovery_stages.isEmpty()) {
 		emit Event(EventCode::DeviceNotFound);
+		return;
 	}
+	StartDiscovery(_discovery_stages.takeFirst());
+}
+
+void DeviceDriver::ConnectPort(const QString& port_name)
+{
+	_discovery_stages.clear();
+	StartDiscovery({port_name});
 }
 
 void DeviceDriver::ReadCounters()
 {
-	static const QByteArray kRequest = CreateReadCountersMessage();
-	if (_connected)
-	{
-		emit Trace(QString("out > ") + kRequest);
-		_serial_port->write(kRequest);
+	typedef Commands::ReadCounters Command;
 
-		if (WaitReadyRead())
-		{
-			auto raw = _serial_port->readAll();
-			emit Trace(QString("in   < ") + raw);
-			if (raw.startsWith(Codes::kSlaveMaster + Codes::kReadCounters)
-					&& CheckCrc(raw))
-			{
-				_counters = Counters::Deserialize(ExtractData(raw));
-				emit Event(EventCode::ReadCountersSuccess);
-				return;
-			}
-		}
-    }
+	if (_connected && _counters_cache.IsFresh(_clock.nsecsElapsed(), _counters_freshness_ns)) {
+		TRACE(Io, Debug, "cache hit : ReadCounters");
+		emit Event(Command::kSuccess);
+		return;
+	}
 
-	CloseSerialPort();
-	emit Event(EventCode::ReadCountersError);
+	Execute<Command>(Command::Frame(), [this](const Counters& counters) {
+		_counters = counters;
+		_counters_cache.Confirm(CounterFields(_counters), _clock.nsecsElapsed());
+	});
 }
 
 void DeviceDriver::WriteCounters(const DeviceDriver::Counters counters)
 {
-	const QByteArray kRequest = CreateWriteCountersMessage(counters);
+	typedef Commands::WriteCounters Command;
 
-	if (_connected)
+	// Устаревшему кэшу не верим и при записи: значение могли изменить с другого хоста
+	if (_connected
+			&& _counters_cache.Matches(CounterFields(counters))
+			&& _counters_cache.IsFresh(_clock.nsecsElapsed(), _counters_freshness_ns))
 	{
-		emit Trace(QString("out > ") + kRequest);
-		_serial_port->write(kRequest);
-
-		if (WaitReadyRead())
-		{
-			auto raw = _serial_port->readAll();
-			emit Trace(QString("in   < ") + raw);
-			if (raw.startsWith(Codes::kSlaveMaster + Codes::kWriteCounters)
-					&& CheckCrc(raw))
-			{
-				emit Event(EventCode::WriteCountersSuccess);
-				return;
-			}
-		}
+		TRACE(Io, Debug, "cache hit : WriteCounters");
+		emit Event(Command::kSuccess);
+		return;
 	}
 
-	CloseSerialPort();
-	emit Event(EventCode::WriteCountersError);
+	_counters_cache.MarkDirty(CounterFields(counters));
+	Execute<Command>(Command::Frame(counters), [this, counters](const Protocol::NoPayload&) {
+		_counters = counters;
+		_counters_cache.Confirm(CounterFields(_counters), _clock.nsecsElapsed());
+	});
 }
 
 void DeviceDriver::ReadParameters()
 {
-	static const QByteArray kRequest = CreateReadParametersMessage();
-	if (_connected)
-	{
-		emit Trace(QString("out > ") + kRequest);
-		_serial_port->write(kRequest);
+	typedef Commands::ReadParameters Command;
 
-		if (WaitReadyRead())
-		{
-			auto raw = _serial_port->readAll();
-			emit Trace(QString("in   < ") + raw);
-			if (raw.startsWith(Codes::kSlaveMaster + Codes::kReadParameters)
-					&& CheckCrc(raw))
-			{
-				_parameters = Parameters::Deserialize(ExtractData(raw));
-				emit Event(EventCode::ReadParametersSuccess);
-				return;
-			}
-		}
+	if (_connected && _parameters_cache.IsFresh(_clock.nsecsElapsed(), _parameters_freshness_ns)) {
+		TRACE(Io, Debug, "cache hit : ReadParameters");
+		emit Event(Command::kSuccess);
+		return;
 	}
 
-	CloseSerialPort();
-	emit Event(EventCode::ReadParametersError);
+	Execute<Command>(Command::Frame(), [this](const Parameters& parameters) {
+		QString error;
+		if (!Validate(parameters, &error)) {
+			TRACE(Io, Warning, "device parameters : " + error);
+		}
+		_parameters = parameters;
+		_parameters_cache.Confirm(ParameterFields(_parameters), _clock.nsecsElapsed());
+	});
 }
 
 void DeviceDriver::WriteParameters(const DeviceDriver::Parameters parameters)
 {
-	const QByteArray kRequest = CreateWriteParametersMessage(parameters);
+	typedef Commands::WriteParameters Command;
 
-	if (_connected)
-	{
-		emit Trace(QString("out > ") + kRequest);
-		_serial_port->write(kRequest);
+	QString error;
+	if (!Validate(parameters, &error)) {
+		TRACE(Io, Error, "WriteParameters rejected : " + error);
+		emit Event(Command::kError);
+		return;
+	}
 
-		if (WaitReadyRead())
-		{
-			auto raw = _serial_port->readAll();
-			emit Trace(QString("in   < ") + raw);
-			if (raw.startsWith(Codes::kSlaveMaster + Codes::kWriteParameters)
-					&& CheckCrc(raw))
-			{
-				emit Event(EventCode::WriteParametersSuccess);
-				return;
-			}
-		}
+	if (_connected
+			&& _parameters_cache.Matches(ParameterFields(parameters))
+			&& _parameters_cache.IsFresh(_clock.nsecsElapsed(), _parameters_freshness_ns))
+	{
+		TRACE(Io, Debug, "cache hit : WriteParameters");
+		emit Event(Command::kSuccess);
+		return;
 	}
 
-	CloseSerialPort();
-	emit Event(EventCode::WriteParametersError);
+	_parameters_cache.MarkDirty(ParameterFields(parameters));
+	Execute<Command>(Command::Frame(parameters), [this, parameters](const Protocol::NoPayload&) {
+		_parameters = parameters;
+		_parameters_cache.Confirm(ParameterFields(_parameters), _clock.nsecsElapsed());
+	});
 }
 
 void DeviceDriver::LaunchSingleCycle()
 {
-	static const QByteArray kRequest = CreateSingleCycleMessage();
-	if (_connected)
-	{
-		emit Trace(QString("out > ") + kRequest);
-		_serial_port->write(kRequest);
+	typedef Commands::LaunchSingleCycle Command;
+	Execute<Command>(Command::Frame(), [this](const MeasuredCharacteristics& characteristics) {
+		_characteristics = characteristics;
+		// Цикл увеличил счетчики
+		_counters_cache.Invalidate();
+	});
+}
 
-		if (WaitReadyRead())
-		{
-			auto raw = _serial_port->readAll();
-			emit Trace(QString("in   < ") + raw);
-			if (raw.startsWith(Codes::kSlaveMaster + Codes::kSingleCycle)
-					&& CheckCrc(raw))
-			{
-				_characteristics = MeasuredCharacteristics::Deserialize(ExtractData(raw));
-				emit Event(EventCode::LaunchSingleCycleSuccess);
-				return;
+void DeviceDriver::ReadSnapshot()
+{
+	typedef Commands::SnapshotCounters CountersCommand;
+	typedef Commands::SnapshotParameters ParametersCommand;
+
+	if (!_connected) {
+		CloseSerialPort();
+		emit Event(CountersCommand::kError);
+		return;
+	}
+
+	// Читается только то, что не подтверждено в пределах окна свежести
+	const qint64 now = _clock.nsecsElapsed();
+	const bool counters_fresh = _counters_cache.IsFresh(now, _counters_freshness_ns);
+	const bool parameters_fresh = _parameters_cache.IsFresh(now, _parameters_freshness_ns);
+	if (counters_fresh && parameters_fresh) {
+		TRACE(Io, Debug, "cache hit : ReadSnapshot");
+		emit Event(CountersCommand::kSuccess);
+		return;
+	}
+
+	// Оба запроса уходят сразу, ответы сопоставляются по коду команды
+	const int batch = NextBatch();
+	if (!counters_fresh) {
+		Execute<CountersCommand>(CountersCommand::Frame(), [this](const Counters& counters) {
+			_counters = counters;
+			_counters_cache.Confirm(CounterFields(_counters), _clock.nsecsElapsed());
+		}, batch);
+	}
+	if (!parameters_fresh) {
+		Execute<ParametersCommand>(ParametersCommand::Frame(), [this](const Parameters& parameters) {
+			QString error;
+			if (!Validate(parameters, &error)) {
+				TRACE(Io, Warning, "device parameters : " + error);
 			}
-		}
+			_parameters = parameters;
+			_parameters_cache.Confirm(ParameterFields(_parameters), _clock.nsecsElapsed());
+		}, batch);
 	}
+}
 
-	CloseSerialPort();
-	emit Event(EventCode::LaunchSingleCycleError);
+void DeviceDriver::SetPipelining(bool enabled)
+{
+	_pipelining = enabled;
+}
+
+void DeviceDriver::StartPolling(int interval_ms, int sources)
+{
+	_poll_sources = sources & (TelemetryCounters | TelemetrySingleCycle);
+	if (!_poll_sources || interval_ms <= 0) {
+		StopPolling();
+		return;
+	}
+
+	_poll_timer->start(interval_ms);
+	Poll();
+}
+
+void DeviceDriver::StopPolling()
+{
+	_poll_timer->stop();
+}
+
+void DeviceDriver::Poll()
+{
+	typedef Commands::TelemetryCounters CountersCommand;
+	typedef Commands::TelemetrySingleCycle SingleCycleCommand;
+
+	// Предыдущий опрос ещё не завершён - такт пропускается
+	if (_poll_in_flight) {
+		return;
+	}
+
+	if (!_connected) {
+		StopPolling();
+		emit Event(CountersCommand::kError);
+		return;
+	}
+
+	_poll_in_flight = true;
+	_poll_received = 0;
+	_poll_sample = {};
+	_poll_sample.sources = _poll_sources;
+
+	const int batch = NextBatch();
+	if (_poll_sources & TelemetryCounters) {
+		Execute<CountersCommand>(CountersCommand::Frame(), [this](const Counters& counters) {
+			_counters = counters;
+			_counters_cache.Confirm(CounterFields(_counters), _clock.nsecsElapsed());
+			_poll_sample.counters = _counters;
+			CompletePoll(TelemetryCounters);
+		}, batch);
+	}
+	if (_poll_sources & TelemetrySingleCycle) {
+		Execute<SingleCycleCommand>(SingleCycleCommand::Frame(), [this](const MeasuredCharacteristics& characteristics) {
+			_characteristics = characteristics;
+			_counters_cache.Invalidate();
+			_poll_sample.characteristics = _characteristics;
+			CompletePoll(TelemetrySingleCycle);
+		}, batch);
+	}
+}
+
+void DeviceDriver::CompletePoll(int source)
+{
+	_poll_received |= source;
+	if (_poll_received == _poll_sample.sources) {
+		_poll_sample.timestamp = QDateTime::currentMSecsSinceEpoch();
+		_telemetry.Push(_poll_sample);
+		_poll_in_flight = false;
+	}
+}
+
+void DeviceDriver::Cancel()
+{
+	AbortTransactions();
+}
+
+void DeviceDriver::SetCacheFreshness(int counters_ms, int parameters_ms)
+{
+	_counters_freshness_ns = qMax(0, counters_ms) * 1000000LL;
+	_parameters_freshness_ns = qMax(0, parameters_ms) * 1000000LL;
+}
+
+void DeviceDriver::InvalidateCache()
+{
+	_counters_cache.Invalidate();
+	_parameters_cache.Invalidate();
 }
 
 void DeviceDriver::HandleError(QSerialPort::SerialPortError error)
 {
 	if (error != QSerialPort::NoError) {
-		emit Trace(QString("serial-port error : ") + _serial_port->errorString());
-		emit Event(EventCode::DeviceDisconnected);
-		CloseSerialPort();
+		TRACE(Io, Error, QString("serial-port error : ") + _serial_port->errorString());
+		Disconnect();
+	}
+}
+
+void DeviceDriver::SetHotPlug(bool enabled)
+{
+	if (!enabled) {
+		delete _port_watcher;
+		_port_watcher = nullptr;
+		return;
 	}
+	if (_port_watcher) {
+		return;
+	}
+
+	// Создаётся в потоке драйвера, чтобы уведомления inotify приходили в него же
+	_port_watcher = new PortWatcher(this);
+	connect(_port_watcher, &PortWatcher::PortAdded, this, &DeviceDriver::HandlePortAdded);
+	connect(_port_watcher, &PortWatcher::PortRemoved, this, &DeviceDriver::HandlePortRemoved);
+}
+
+void DeviceDriver::Close()
+{
+	SetHotPlug(false);
+	_discovery->Cancel();
+	_discovery_stages.clear();
+	CloseSerialPort();
+}
+
+void DeviceDriver::Publish()
+{
+	DeviceSnapshot snapshot = {};
+	snapshot.connected = _connected;
+	snapshot.counters = _counters;
+	snapshot.parameters = _parameters;
+	snapshot.characteristics = _characteristics;
+	_snapshot.Store(snapshot);
 }
 
 void DeviceDriver::CloseSerialPort()
 {
 	_connected = false;
+	_poll_timer->stop();
+	AbortTransactions();
+	_frame_parser.Reset();
+	// Следующим может оказаться другое устройство, а недошедшая запись
+	// оставила поля неизвестными
+	InvalidateCache();
+
 	if (_serial_port) {
+		_serial_port->disconnect(this);
 		if (_serial_port->isOpen()) {
 			_serial_port->close();
 		}
@@ -234,302 +518,476 @@ void DeviceDriver::CloseSerialPort()
 		_serial_port->deleteLater();
 		_serial_port = nullptr;
 	}
+	Publish();
 }
 
-bool DeviceDriver::CheckSerialPort(const QSerialPortInfo & info)
+void DeviceDriver::StartDiscovery(const QStringList& ports)
 {
-	const auto ping = CreatePingMessage();
+	static const int kDiscoveryTimeout = 2000;
 
-	if (!_serial_port)
-	{
-		_serial_port = new QSerialPort(info, this);
-		_serial_port->setBaudRate(QSerialPort::Baud115200);
-		_serial_port->setDataBits(QSerialPort::Data8);
-		_serial_port->setParity(QSerialPort::Parity::NoParity);
-		_serial_port->setStopBits(QSerialPort::StopBits::OneStop);
-		_serial_port->setFlowControl(QSerialPort::FlowControl::NoFlowControl);
-
-		emit Trace(QString("Try open -> ") + info.portName());
-		if (_serial_port->open(QIODevice::ReadWrite))
-		{
-			emit Trace(QString("out > ") + ping);
-			_serial_port->write(ping);
-
-			if (WaitReadyRead())
-			{
-				auto raw =_serial_port->readAll();
-				emit Trace("in   < " + raw);
-				if (raw.startsWith(Codes::kSlaveMaster + Codes::kPing))
-				{
-					connect(_serial_port,
-							&QSerialPort::errorOccurred,
-							this,
-							&DeviceDriver::HandleError);
-					return true;
-					emit Trace("ok : " + info.portName());
-				}
-			}
-		}
+	if (_discovery->IsRunning()) {
+		return;
 	}
-
-	emit Trace("error : " + info.portName());
 	CloseSerialPort();
-	return false;
+
+	_discovery->SetBaudRates(DiscoveryBaudRates());
+	_discovery->SetVerification(Commands::ReadCounters::Frame(),
+								Commands::ReadCounters::Reply(),
+								kBaudVerifyCount);
+	_discovery->Start(ports,
+					  CreatePingMessage(),
+					  QByteArray::fromRawData(Protocol::FixedFrame<Protocol::Opcode::Ping>::kReply,
+											  sizeof(Protocol::FixedFrame<Protocol::Opcode::Ping>::kReply)),
+					  kDiscoveryTimeout);
 }
 
-bool DeviceDriver::WaitReadyRead()
+void DeviceDriver::AttachSerialPort(QSerialPort* port)
 {
-	if(_serial_port
-			&& _serial_port->waitForBytesWritten(2000)
-			&& _serial_port->waitForReadyRead(2000))
-	{
-		return true;
+	CloseSerialPort();
+
+	_serial_port = port;
+	_serial_port->setParent(this);
+	// Оценки обмена сохраняются при переподключении к тому же порту
+	if (_port_name != _serial_port->portName()) {
+		_port_name = _serial_port->portName();
+		_rtt.clear();
 	}
-	return false;
+	_discovery_stages.clear();
+	PortCache::Remember(QSerialPortInfo(*_serial_port), _serial_port->baudRate());
+	_last_cycle_ns = 0;
+	_capture_registered = nullptr;
+	connect(_serial_port,
+			&QSerialPort::errorOccurred,
+			this,
+			&DeviceDriver::HandleError);
+	connect(_serial_port,
+			&QSerialPort::readyRead,
+			this,
+			&DeviceDriver::HandleReadyRead);
+	connect(_serial_port,
+			&QSerialPort::bytesWritten,
+			this,
+			&DeviceDriver::HandleBytesWritten);
+
+	_connected = true;
+	Publish();
+	emit Event(EventCode::DeviceFound);
+}
+
+void DeviceDriver::Disconnect()
+{
+	_stats.RecordDisconnect(_port_name);
+	for (const auto& transaction : _transactions) {
+		_stats.RecordOutcome(_port_name, CommandName(transaction.request), DeviceStats::Aborted);
+	}
+	emit Event(EventCode::DeviceDisconnected);
+	CloseSerialPort();
 }
 
-QByteArray DeviceDriver::CreatePingMessage() const
+void DeviceDriver::HandlePortAdded(const QSerialPortInfo& port)
 {
-	return (Codes::kMasterSlave + Codes::kPing + Codes::kCRLF).toUpper();
+	TRACE(Discovery, Info, "port added : " + port.portName());
+	if (_connected || _discovery->IsRunning()) {
+		return;
+	}
+	// Без запроса пользователя пингуются только знакомые адаптеры: в чужое
+	// устройство (модем, GPS) писать нельзя. Остальные порты видны в списке
+	// и проверяются при явном поиске
+	if (!IsCachedPort(PortCache::Load(), port) && !PortCache::IsKnownUsbId(port)) {
+		TRACE(Discovery, Info, "port skipped : " + port.portName());
+		return;
+	}
+	_discovery_stages.clear();
+	StartDiscovery({port.portName()});
 }
 
-QByteArray DeviceDriver::CreateReadCountersMessage() const
+void DeviceDriver::HandlePortRemoved(const QString& port_name)
 {
-	auto result = Codes::kReadCounters;
-	AppendCrc(result);
-	return (Codes::kMasterSlave + result + Codes::kCRLF).toUpper();
+	TRACE(Discovery, Info, "port removed : " + port_name);
+	if (_serial_port && _serial_port->portName() == port_name) {
+		Disconnect();
+	}
 }
 
-QByteArray DeviceDriver::CreateReadParametersMessage() const
+void DeviceDriver::Enqueue(const QByteArray& request,
+						   const QByteArray& reply,
+						   EventCode success,
+						   EventCode error,
+						   std::function<bool(const char*, size_t)> handler,
+						   int batch)
 {
-	auto result = Codes::kReadParameters;
-	AppendCrc(result);
-	return (Codes::kMasterSlave + result + Codes::kCRLF).toUpper();
-}
+	if (!_connected) {
+		CloseSerialPort();
+		emit Event(error);
+		return;
+	}
 
-QByteArray DeviceDriver::CreateSingleCycleMessage() const
-{
-	auto result = Codes::kSingleCycle;
-	AppendCrc(result);
-	return (Codes::kMasterSlave + result + Codes::kCRLF).toUpper();
+	const bool pipelined = _pipelining || batch != 0;
+	_transactions.enqueue({request, reply, success, error, handler, batch, pipelined, 0, 0,
+						   _clock.nsecsElapsed(), 0, 0, 0, 0});
+	SendTransactions();
 }
 
-QByteArray DeviceDriver::CreateWriteCountersMessage(const DeviceDriver::Counters & counters) const
+template <class Command>
+void DeviceDriver::Execute(const QByteArray& frame,
+						   std::function<void(const typename Command::Response&)> handler,
+						   int batch)
 {
-	QByteArray result = Codes::kWriteCounters + Counters::Serialize(counters);
-	AppendCrc(result);
-	return (Codes::kMasterSlave + result + Codes::kCRLF).toUpper();
+	// Ответ проверяется всегда, даже если его данные не нужны
+	const auto parse = [handler](const char* data, size_t size) {
+		typename Command::Response response = {};
+		if (!Command::Parse(data, size, &response)) {
+			return false;
+		}
+		if (handler) {
+			handler(response);
+		}
+		return true;
+	};
+	Enqueue(frame, Command::Reply(), Command::kSuccess, Command::kError, parse, batch);
 }
 
-QByteArray DeviceDriver::CreateWriteParametersMessage(const DeviceDriver::Parameters & parameters) const
+int DeviceDriver::NextBatch()
 {
-	QByteArray result = Codes::kWriteParameters + Parameters::Serialize(parameters);
-	AppendCrc(result);
-	return (Codes::kMasterSlave + result + Codes::kCRLF).toUpper();
+	if (++_last_batch <= 0) {
+		_last_batch = 1;
+	}
+	return _last_batch;
 }
 
-unsigned char CRC8IN(unsigned char last_crc, unsigned char input_data)
+bool DeviceDriver::CanSend(int index) const
 {
-	const unsigned char kPolynomial = 0x31;
-	unsigned char crc = last_crc;
-	crc ^= input_data;
-	for(int i = 8; i; --i) {
-		crc = (crc & 0x80)
-				? ((crc << 1) ^ kPolynomial)
-				: (crc << 1);
+	const auto& transaction = _transactions.at(index);
+
+	// Все предыдущие транзакции уже отправлены и ждут ответа
+	for (int i = 0; i < index; ++i) {
+		const auto& in_flight = _transactions.at(i);
+		if (!transaction.pipelined
+				|| !in_flight.pipelined
+				|| in_flight.reply == transaction.reply)
+		{
+			return false;
+		}
 	}
-	return crc;
+	return true;
 }
 
-void DeviceDriver::AppendCrc(QByteArray & data) const
+void DeviceDriver::SendTransactions()
 {
-	data.append(CalculateCrc(data));
+	for (int i = 0; i < _transactions.size(); ++i) {
+		if (_transactions.at(i).timer_id) {
+			continue;
+		}
+		if (!CanSend(i)) {
+			break;
+		}
+
+		auto& transaction = _transactions[i];
+		TRACE_FRAME(Out, transaction.request);
+		CaptureTraffic(Capture::Transmit, transaction.request);
+		Protocol::Opcode code;
+		if (Protocol::FrameCode(transaction.request.constData(), static_cast<size_t>(transaction.request.size()), &code)
+				&& code == Protocol::Opcode::SingleCycle)
+		{
+			transaction.allowance_ms = CycleAllowance();
+		}
+		transaction.unwritten = transaction.request.length();
+		transaction.timer_id = startTimer(WriteTimeout(transaction.unwritten));
+		transaction.sent_ns = _clock.nsecsElapsed();
+		if (_serial_port->write(transaction.request) < 0) {
+			FailTransactions(i, DeviceStats::WriteError);
+			return;
+		}
+	}
 }
 
-QByteArray DeviceDriver::CalculateCrc(const QByteArray& data) const
+void DeviceDriver::FinishTransaction(int index, const QByteArray& raw)
 {
-	QByteArray tmp = QByteArray::fromHex(data);
+	// Данные между кодом команды и CRC разбираются прямо в кадре. Верный CRC
+	// при неразборчивых данных - сбой, а не нулевые значения
+	const auto& pending = _transactions.at(index);
+	if (pending.handler) {
+		const auto data = Protocol::ReplyData(raw.constData(), static_cast<size_t>(raw.size()));
+		if (!pending.handler(data.data, data.size)) {
+			TRACE(Io, Error, "malformed reply : " + raw.trimmed());
+			FailTransactions(index, DeviceStats::Malformed);
+			return;
+		}
+		Publish();
+	}
 
-	unsigned char last_crc = 0xFF;
-	for (auto byte : tmp) {
-		last_crc = CRC8IN(last_crc, static_cast<unsigned char>(byte));
+	const auto transaction = _transactions.takeAt(index);
+	killTimer(transaction.timer_id);
+	const qint64 now = _clock.nsecsElapsed();
+	const QString command = CommandName(transaction.request);
+	RecordTimings(transaction, now);
+	_stats.RecordOutcome(_port_name, command, DeviceStats::Success);
+
+	// В замер идёт только обмен, ожидаемая длительность цикла вычитается
+	if (transaction.written_ns) {
+		_rtt[command].Sample((now - transaction.written_ns) / 1e6 - transaction.allowance_ms);
+	}
+	if (transaction.allowance_ms) {
+		_last_cycle_ns = now;
 	}
 
-	QByteArray crc;
-	crc = crc.append(last_crc).toHex();
-	crc = crc.toUpper();
-	return crc;
+	// Событие пакета выдаётся после ответа на последний его запрос
+	bool completed = true;
+	if (transaction.batch) {
+		for (const auto& other : _transactions) {
+			completed = completed && other.batch != transaction.batch;
+		}
+	}
+	if (completed) {
+		emit Event(transaction.success);
+	}
+
+	SendTransactions();
 }
 
-QByteArray DeviceDriver::ExtractBody(const QByteArray & data) const
+void DeviceDriver::FailTransactions(int index, DeviceStats::Outcome outcome)
 {
-	const unsigned int kCrcLength = 2;
-	const unsigned int kMessageIndex = 1;
-	const int kMessageLength = data.length()
-			- kMessageIndex
-			- Codes::kCRLF.length()
-			- kCrcLength;
+	QList<EventCode> errors;
+	QList<int> batches;
+	for (int i = 0; i < _transactions.size(); ++i) {
+		const auto& transaction = _transactions.at(i);
+		_stats.RecordOutcome(_port_name,
+							 CommandName(transaction.request),
+							 i == index ? outcome : DeviceStats::Aborted);
+
+		if (transaction.batch) {
+			if (batches.contains(transaction.batch)) {
+				continue;
+			}
+			batches.append(transaction.batch);
+		}
+		errors.append(transaction.error);
+	}
 
-	QByteArray result;
-	if (kMessageLength > 0) {
-		result.append(data.mid(kMessageIndex, kMessageLength));
+	CloseSerialPort();
+	for (auto error : errors) {
+		emit Event(error);
 	}
-	return result;
 }
 
-QByteArray DeviceDriver::ExtractData(const QByteArray & data) const
+void DeviceDriver::AbortTransactions()
 {
-	const unsigned int kCrcLength = 2;
-	const unsigned int kMessageIndex = 3;
-	const int kMessageLength = data.length()
-			- kMessageIndex
-			- Codes::kCRLF.length()
-			- kCrcLength;
-
-	QByteArray result;
-	if (kMessageLength > 0) {
-		result.append(data.mid(kMessageIndex, kMessageLength));
+	_poll_in_flight = false;
+	while (!_transactions.isEmpty()) {
+		killTimer(_transactions.dequeue().timer_id);
 	}
-	return result;
 }
 
-QByteArray DeviceDriver::ExtractCrc(const QByteArray & data) const
+void DeviceDriver::HandleReadyRead()
 {
-	const unsigned int kCrcLength = 2;
-	const unsigned int kMessageIndex = 1;
-	const int kMessageLength = data.length()
-			- kMessageIndex
-			- Codes::kCRLF.length()
-			- kCrcLength;
-	const unsigned int kCrcIndex = kMessageIndex + kMessageLength;
+	const auto chunk = _serial_port->readAll();
+	CaptureTraffic(Capture::Receive, chunk);
+	_frame_parser.Append(chunk, _clock.nsecsElapsed());
+
+	while (_serial_port && _frame_parser.HasFrame()) {
+		const auto frame = _frame_parser.TakeFrame();
+		TRACE_FRAME(In, frame.raw);
 
-	QByteArray result;
+		// Ответ сопоставляется с отправленной транзакцией по коду команды,
+		// прочие кадры (запоздавшие ответы) пропускаются
+		int index = -1;
+		for (int i = 0; i < _transactions.size() && _transactions.at(i).timer_id; ++i) {
+			if (_transactions.at(i).unwritten == 0
+					&& frame.raw.startsWith(_transactions.at(i).reply))
+			{
+				index = i;
+				break;
+			}
+		}
+		if (index < 0) {
+			continue;
+		}
 
-	if (kMessageLength > 0) {
-		result.append(data.mid(kCrcIndex, kCrcLength));
+		// Первый байт ответа - начало его собственного кадра: хвост кадра
+		// предыдущей транзакции в конвейере не засчитывается следующей
+		auto& transaction = _transactions[index];
+		if (!transaction.first_byte_ns) {
+			transaction.first_byte_ns = frame.started;
+		}
+
+		if (frame.crc_ok) {
+			FinishTransaction(index, frame.raw);
+		} else {
+			TRACE(Crc, Warning, "crc error : " + frame.raw.trimmed());
+			FailTransactions(index, DeviceStats::CrcError);
+		}
 	}
-	return result;
 }
 
-bool DeviceDriver::CheckCrc(const QByteArray& data) const
+void DeviceDriver::HandleBytesWritten(qint64 bytes)
 {
-	auto crc = ExtractCrc(data);
-	auto tmp = ExtractBody(data);
-	auto calc_crc = CalculateCrc(tmp);
-	if (crc.length()
-			&& tmp.length()
-			&& calc_crc.length()
-			&& calc_crc == crc)
-	{
-		return true;
+	// Байты уходят в порт в порядке отправки транзакций
+	for (int i = 0; i < _transactions.size() && bytes > 0; ++i) {
+		auto& transaction = _transactions[i];
+		if (!transaction.timer_id || transaction.unwritten == 0) {
+			continue;
+		}
+
+		const qint64 written = qMin(bytes, transaction.unwritten);
+		transaction.unwritten -= written;
+		bytes -= written;
+
+		if (transaction.unwritten == 0) {
+			killTimer(transaction.timer_id);
+			transaction.timer_id = startTimer(_rtt[CommandName(transaction.request)].Timeout()
+											  + transaction.allowance_ms);
+			transaction.written_ns = _clock.nsecsElapsed();
+		}
 	}
-	return false;
 }
 
-template <class T>
-QByteArray ValueToRaw(T value)
+void DeviceDriver::CaptureTraffic(Capture::RecordType type, const QByteArray& data)
 {
-	const int kSize = sizeof (T);
-	QByteArray result;
+	const auto capture = _capture.load(std::memory_order_acquire);
+	if (!capture || !_serial_port) {
+		return;
+	}
 
-	for (int i = 0; i < kSize; ++i) {
-		result.append(static_cast<unsigned char>(value & 0xff));
-		value >>= 8;
+	if (capture != _capture_registered) {
+		_capture_port = capture->RegisterPort(_serial_port->portName().toStdString());
+		_capture_registered = capture;
 	}
-	return result.toHex();
+	capture->Record(_capture_port, type, data.constData(), data.size());
 }
 
-QByteArray DeviceDriver::Counters::Serialize(const DeviceDriver::Counters & counters)
+void DeviceDriver::RecordTimings(const Transaction& transaction, qint64 now)
 {
-	QByteArray result;
-	result.append(ValueToRaw<uint32_t>(counters.cycles));
-	result.append(ValueToRaw<uint32_t>(counters.time));
-	return result;
+	const QString command = CommandName(transaction.request);
+	const auto record = [&](DeviceStats::Stage stage, qint64 from, qint64 to) {
+		if (from && to) {
+			_stats.RecordLatency(_port_name, command, stage, (to - from) / 1000);
+		}
+	};
+
+	record(DeviceStats::QueueWait, transaction.enqueued_ns, transaction.sent_ns);
+	record(DeviceStats::WriteDone, transaction.sent_ns, transaction.written_ns);
+	record(DeviceStats::FirstByte, transaction.sent_ns, transaction.first_byte_ns);
+	record(DeviceStats::FullFrame, transaction.sent_ns, now);
 }
 
-template<class T>
-T ValueFromRaw(const QByteArray& raw) {
-	uint32_t result = 0;
-	const int kRawSize = sizeof (T);
-	if (raw.length() >= kRawSize) {
-		QByteArray tmp = raw.mid(0, kRawSize);
-		std::reverse(tmp.begin(), tmp.end());
-		for (int i = 0; i < kRawSize; ++i) {
-			result <<= 8;
-			result += static_cast<unsigned char>(tmp[i]);
-		}
-	}
+int DeviceDriver::WriteTimeout(qint64 bytes) const
+{
+	static const int kWriteMargin = 50; // задержки драйвера и USB-моста (мс)
+	static const int kBitsPerByte = 10; // 8N1 со стартовым и стоповым битами
 
-	return result;
+	const qint32 baud_rate = _serial_port ? qMax(1, _serial_port->baudRate()) : QSerialPort::Baud115200;
+	const qint64 transfer_ms = bytes * kBitsPerByte * 1000 / baud_rate;
+	return static_cast<int>(kWriteMargin + 2 * transfer_ms);
 }
 
-DeviceDriver::Counters DeviceDriver::Counters::Deserialize(const QByteArray & raw)
+int DeviceDriver::CycleAllowance() const
 {
-	const int kRawSize = 8;
-	Counters result = {};
-	QByteArray tmp = QByteArray::fromHex(raw);
-	if (tmp.length() == kRawSize) {
+	static const int kMaxCycleTime = 600; // верхняя граница tw (мс)
 
-		result.cycles = ValueFromRaw<uint32_t>(tmp);
-		tmp.remove(0, sizeof (uint32_t));
+	// Время цикла задано программно - tw, иначе резистором и заранее неизвестно
+	const int cycle = (_parameters.ct == 0xFF && _parameters.tw)
+			? _parameters.tw
+			: kMaxCycleTime;
 
-		result.time = ValueFromRaw<uint32_t>(tmp);
+	// До конца паузы tbc после прошлого цикла устройство может отложить пуск
+	int pause = 0;
+	if (_last_cycle_ns) {
+		const qint64 since_ms = (_clock.nsecsElapsed() - _last_cycle_ns) / 1000000;
+		pause = static_cast<int>(qMax<qint64>(0, _parameters.tbc - since_ms));
 	}
-	return result;
+	return cycle + pause;
 }
 
-QByteArray DeviceDriver::Parameters::Serialize(const DeviceDriver::Parameters & parameters)
+void DeviceDriver::timerEvent(QTimerEvent* event)
 {
-	QByteArray result;
-	result.append(ValueToRaw<uint16_t>(parameters.cpm));
-	result.append(ValueToRaw<uint16_t>(parameters.tp));
-	result.append(ValueToRaw<uint16_t>(parameters.tbc));
-	result.append(ValueToRaw<uint16_t>(parameters.tbtp));
-	result.append(ValueToRaw<uint8_t>(parameters.ct));
-	result.append(ValueToRaw<uint16_t>(parameters.tw));
-	return result;
+	for (int i = 0; i < _transactions.size(); ++i) {
+		const auto& transaction = _transactions.at(i);
+		if (transaction.timer_id == event->timerId()) {
+			TRACE(Io, Warning, "timeout : " + transaction.request.trimmed());
+			if (transaction.written_ns) {
+				_rtt[CommandName(transaction.request)].Backoff();
+			}
+			FailTransactions(i, DeviceStats::Timeout);
+			return;
+		}
+	}
+	killTimer(event->timerId());
 }
 
-DeviceDriver::Parameters DeviceDriver::Parameters::Deserialize(const QByteArray & raw)
+QByteArray DeviceDriver::CreatePingMessage()
 {
-	const int kRawSize = 11;
-	Parameters result = {};
-	QByteArray tmp = QByteArray::fromHex(raw);
+	return QByteArray::fromRawData(Protocol::kPingRequest, sizeof(Protocol::kPingRequest));
+}
 
-	if (tmp.length() == kRawSize) {
+QByteArray DeviceDriver::CreateReadCountersMessage()
+{
+	return Commands::ReadCounters::Frame();
+}
 
-		result.cpm = ValueFromRaw<uint16_t>(tmp);
-		tmp.remove(0, sizeof (uint16_t));
+QByteArray DeviceDriver::CreateReadParametersMessage()
+{
+	return Commands::ReadParameters::Frame();
+}
 
-		result.tp = ValueFromRaw<uint16_t>(tmp);
-		tmp.remove(0, sizeof (uint16_t));
+QByteArray DeviceDriver::CreateSingleCycleMessage()
+{
+	return Commands::LaunchSingleCycle::Frame();
+}
 
-		result.tbc = ValueFromRaw<uint16_t>(tmp);
-		tmp.remove(0, sizeof (uint16_t));
+QByteArray DeviceDriver::CreateWriteCountersMessage(const DeviceDriver::Counters & counters)
+{
+	return Commands::WriteCounters::Frame(counters);
+}
 
-		result.tbtp = ValueFromRaw<uint16_t>(tmp);
-		tmp.remove(0, sizeof (uint16_t));
+QByteArray DeviceDriver::CreateWriteParametersMessage(const DeviceDriver::Parameters & parameters)
+{
+	return Commands::WriteParameters::Frame(parameters);
+}
 
-		result.ct = ValueFromRaw<uint8_t>(tmp);
-		tmp.remove(0, sizeof (uint8_t));
+void DeviceDriver::AppendCrc(QByteArray & data)
+{
+	data.append(CalculateCrc(data));
+}
 
-		result.tw = ValueFromRaw<uint16_t>(tmp);
-	}
+QByteArray DeviceDriver::CalculateCrc(const QByteArray& data)
+{
+	const uint8_t crc = Kernels::Crc8Hex(data.constData(), data.size());
+
+	QByteArray result(2, Qt::Uninitialized);
+	Kernels::HexEncode(&crc, 1, result.data(), true);
 	return result;
 }
 
-DeviceDriver::MeasuredCharacteristics DeviceDriver::MeasuredCharacteristics::Deserialize(const QByteArray& raw)
+QByteArray DeviceDriver::ExtractBody(const QByteArray & data)
 {
-	const int kRawSize = 4;
-	MeasuredCharacteristics result = {};
-	QByteArray tmp = QByteArray::fromHex(raw);
+	// Код и данные: между началом кадра и CRC
+	const int kBodyLength = data.size() - static_cast<int>(Protocol::kFrameOverhead - Protocol::kCodeLength);
+	return kBodyLength > 0 ? data.mid(1, kBodyLength) : QByteArray();
+}
 
-	if (tmp.length() == kRawSize) {
+QByteArray DeviceDriver::ExtractData(const QByteArray & data)
+{
+	const auto reply = Protocol::ReplyData(data.constData(), static_cast<size_t>(data.size()));
+	return QByteArray(reply.data, static_cast<int>(reply.size));
+}
 
-		result.vlt = ValueFromRaw<uint16_t>(tmp);
-		tmp.remove(0, sizeof (uint16_t));
+QByteArray DeviceDriver::ExtractCrc(const QByteArray & data)
+{
+	const int kBodyLength = data.size() - static_cast<int>(Protocol::kFrameOverhead - Protocol::kCodeLength);
+	return kBodyLength > 0 ? data.mid(1 + kBodyLength, Protocol::kCrcLength) : QByteArray();
+}
 
-		result.curr = ValueFromRaw<uint16_t>(tmp);
+bool DeviceDriver::CheckCrc(const QByteArray& data)
+{
+	// Без копий тела и CRC: считается прямо по hex внутри кадра
+	return Protocol::CheckCrc(data.constData(), static_cast<size_t>(data.size()));
+}
+
+bool DeviceDriver::Validate(const DeviceDriver::Parameters & parameters, QString* error)
+{
+	const auto field = Protocol::Validate(parameters);
+	if (field && error) {
+		*error = QString("%1=%2 out of range").arg(field->name).arg(field->get(parameters));
 	}
-	return result;
+	return !field;
 }
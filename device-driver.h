@@ -2,8 +2,30 @@
 #define DEVICEDRIVER_H
 
 #include <QSerialPort>
+#include <QSerialPortInfo>
+#include <QStringList>
 #include <QObject>
-#include <QMutex>
+#include <QQueue>
+#include <QVector>
+#include <QElapsedTimer>
+#include <QHash>
+
+#include "capture-file.h"
+#include "device-stats.h"
+#include "field-cache.h"
+#include "frame-parser.h"
+#include "protocol-structs.h"
+#include "ring-buffer.h"
+#include "rtt-estimator.h"
+#include "seqlock.h"
+#include "tracing.h"
+
+#include <atomic>
+#include <functional>
+
+class DeviceDiscovery;
+class PortWatcher;
+class QTimer;
 
 class DeviceDriver : public QObject
 {
@@ -27,49 +49,92 @@ public:
 		LaunchSingleCycleSuccess,
 		LaunchSingleCycleError,
 
+		ReadSnapshotSuccess,
+		ReadSnapshotError,
+
+		TelemetrySampled,
+		TelemetryError,
+
 		DeviceNotFound,
 		DeviceFound,
 		DeviceDisconnected
     };
 
-    // Счетчики
-    struct Counters {
-        uint32_t time; // общее время работы (с)
-        uint32_t cycles; // общее количество циклов
-		static QByteArray Serialize(const Counters&);
-		static Counters Deserialize(const QByteArray&);
+	// Данные команд, раскладка на линии - в protocol/protocol-structs.h
+	typedef Protocol::Counters Counters;
+	typedef Protocol::Parameters Parameters;
+	typedef Protocol::MeasuredCharacteristics MeasuredCharacteristics;
+
+    // Согласованный снимок состояния устройства
+    struct DeviceSnapshot {
+        quint64 generation; // номер публикации, растёт с каждым изменением
+        bool connected;
+        Counters counters;
+        Parameters parameters;
+        MeasuredCharacteristics characteristics;
     };
 
-    // Параметры
-    struct Parameters {
-        uint16_t cpm; // граница тока мотора (мА)
-        uint16_t tp; // время теста насоса [0 .. 10 000](мс)
-        uint16_t tbc; // время паузы между циклами [0 .. 60 000](мс)
-        uint16_t tbtp; // время между тестами насоса [0 .. 28 800](c)
-        uint8_t ct; // время цикла установлена [программно (0xFF) / от внутреннего резистора (0x00)]
-        uint16_t tw; // время цикла, если программно [40 .. 600](мс)
-		static QByteArray Serialize(const Parameters&);
-		static Parameters Deserialize(const QByteArray&);
+    // Источники данных для режима опроса
+    enum TelemetrySource {
+        TelemetryCounters = 0x01, // чтение счетчиков
+        TelemetrySingleCycle = 0x02 // пуск цикла и измерение vlt/curr
     };
 
-    // Измеренные характеристики
-    struct MeasuredCharacteristics {
-        uint16_t vlt; // напряжение питания платы цмр = 0.01 (В)
-        uint16_t curr; // ток насоса во время цикла цмр = 0.01 (А)
-		static MeasuredCharacteristics Deserialize(const QByteArray&);
-     };
+    // Отсчёт телеметрии
+    struct TelemetrySample {
+        qint64 timestamp; // мс с начала эпохи
+        int sources; // какие поля заполнены (TelemetrySource)
+        Counters counters;
+        MeasuredCharacteristics characteristics;
+    };
 
 public:
     explicit DeviceDriver(QObject *parent = nullptr);
 	~DeviceDriver();
 
-	Counters GetCounters();
-	Parameters GetParameters();
-	MeasuredCharacteristics GetCharacteristics();
-	bool IsConnected();
+	// Чтение из любого потока без блокировок
+	DeviceSnapshot GetSnapshot() const;
+	Counters GetCounters() const;
+	Parameters GetParameters() const;
+	MeasuredCharacteristics GetCharacteristics() const;
+	bool IsConnected() const;
+
+	// Забрать накопленные отсчёты телеметрии, не блокируя поток драйвера.
+	// Вызывается только из одного потока-потребителя
+	int DrainTelemetry(QVector<TelemetrySample>&, int max = -1);
+	quint64 DroppedTelemetry() const;
+
+	// Запись обмена с портом, nullptr - выключить. Писатель должен жить
+	// дольше драйвера; вызов допустим из любого потока
+	void SetCapture(CaptureWriter*);
+
+	// Задержки и исходы транзакций по командам; из любого потока
+	DeviceStats::Report GetStats() const;
+	void ResetStats();
+
+	// Кодек кадров протокола поверх protocol/, не зависит от состояния драйвера
+	static QByteArray CreatePingMessage();
+	static QByteArray CreateReadCountersMessage();
+	static QByteArray CreateReadParametersMessage();
+	static QByteArray CreateSingleCycleMessage();
+
+	static QByteArray CreateWriteCountersMessage(const Counters &);
+	static QByteArray CreateWriteParametersMessage(const Parameters&);
+
+	static void AppendCrc(QByteArray&);
+	static bool CheckCrc(const QByteArray&);
+	static QByteArray CalculateCrc(const QByteArray&);
+	static QByteArray ExtractBody(const QByteArray&);
+	static QByteArray ExtractData(const QByteArray&);
+	static QByteArray ExtractCrc(const QByteArray&);
+
+	// Пределы полей Parameters; error - первое неверное поле
+	static bool Validate(const Parameters&, QString* error = nullptr);
 
 public slots:
 	void FindDevice();
+	// Подключение к заданному порту без перебора остальных; имя или путь
+	void ConnectPort(const QString&);
 
     void ReadCounters();
     void WriteCounters(const Counters);
@@ -79,43 +144,151 @@ public slots:
 
     void LaunchSingleCycle();
 
+	// Счетчики и параметры одним пакетом, без ожидания ответа между запросами
+	void ReadSnapshot();
+
+	// Конвейерный режим: следующая команда отправляется, не дожидаясь
+	// ответа на предыдущую, если их коды ответа различаются
+	void SetPipelining(bool);
+
+	// Периодический опрос: источники из TelemetrySource, период в мс
+	void StartPolling(int interval_ms, int sources);
+	void StopPolling();
+
+	// Сброс очереди команд без уведомлений
+	void Cancel();
+
+	// Чтения в пределах окна свежести отвечаются из кэша без обмена,
+	// запись совпадающих с кэшем значений пропускается; 0 - всегда в порт.
+	// По умолчанию кэш выключен: параметры может сменить другой хост или
+	// панель устройства, и устаревшее значение допустимо не для всех вызовов
+	void SetCacheFreshness(int counters_ms, int parameters_ms);
+	// Следующие чтение и запись обязательно уйдут в устройство
+	void InvalidateCache();
+
+	// Слежение за появлением и исчезновением портов: новый порт из PortCache
+	// или с известным USB VID/PID сразу проверяется, если устройство не
+	// подключено, а пропажа узла текущего порта сразу даёт DeviceDisconnected
+	void SetHotPlug(bool);
+
+	// Остановка поиска, опроса и слежения за портами, закрытие порта.
+	// Вызывается в потоке драйвера до его остановки: таймеры и уведомители
+	// нельзя останавливать из другого потока
+	void Close();
+
 	void HandleError(QSerialPort::SerialPortError error);
 signals:
 	void Event(EventCode);
 	void Trace(const QString&);
+	// Кадр обмена без форматирования, см. Tracing::Io
+	void TraceFrame(Tracing::Direction, const QByteArray&);
 
 private:
-    bool _connected;
+	std::atomic<bool> _connected;
+	// Рабочие копии потока драйвера, читателям они публикуются через _snapshot
 	Counters _counters;
 	Parameters _parameters;
 	MeasuredCharacteristics _characteristics;
-	QMutex _data_mutex;
+	SeqLock<DeviceSnapshot> _snapshot;
 
 	QSerialPort* _serial_port;
+	DeviceDiscovery* _discovery;
+	QList<QStringList> _discovery_stages; // очередные группы портов для поиска
+	PortWatcher* _port_watcher; // nullptr - порты перечисляются при каждом поиске
+
+	// Транзакция запрос -> ответ
+	struct Transaction {
+		QByteArray request;
+		QByteArray reply; // ожидаемое начало ответа
+		EventCode success;
+		EventCode error;
+		// Разбор hex-данных ответа в буфере кадра; false - данные не разбираются
+		std::function<bool(const char*, size_t)> handler;
+		int batch; // номер пакета, 0 - одиночная команда
+		bool pipelined;
+		qint64 unwritten; // байты запроса, ещё не ушедшие в порт
+		int timer_id; // 0 - транзакция ещё не отправлена
+		// Отметки времени по _clock (нс), 0 - этап не пройден
+		qint64 enqueued_ns;
+		qint64 sent_ns;
+		qint64 written_ns;
+		qint64 first_byte_ns;
+		int allowance_ms; // работа устройства сверх обмена (цикл), добавляется к таймауту
+	};
+
+	QQueue<Transaction> _transactions; // отправленные транзакции всегда в начале очереди
+	bool _pipelining;
+	int _last_batch;
+
+	QTimer* _poll_timer;
+	int _poll_sources;
+	int _poll_received; // источники, уже ответившие в текущем опросе
+	bool _poll_in_flight;
+	TelemetrySample _poll_sample;
+
+	// Значения, подтверждённые устройством, по полям Counters и Parameters
+	FieldCache<2> _counters_cache;
+	FieldCache<6> _parameters_cache;
+	qint64 _counters_freshness_ns;
+	qint64 _parameters_freshness_ns;
+	SpscRingBuffer<TelemetrySample> _telemetry;
+	FrameParser _frame_parser;
+
+	std::atomic<CaptureWriter*> _capture;
+	CaptureWriter* _capture_registered; // писатель, знающий текущий порт
+	uint16_t _capture_port;
+
+	QElapsedTimer _clock;
+	DeviceStats _stats;
+	QString _port_name; // порт для статистики, живёт дольше _serial_port
+
+	// Таймауты ответа по командам для порта _port_name
+	QHash<QString, RttEstimator> _rtt;
+	qint64 _last_cycle_ns; // окончание последнего цикла по _clock, 0 - не было
+
+protected:
+	void timerEvent(QTimerEvent*) override;
 
 private:
+	void Publish();
 	void CloseSerialPort();
-	bool CheckSerialPort(const QSerialPortInfo&);
-
-	bool WaitReadyRead();
-	QByteArray CreatePingMessage() const;
-	QByteArray CreateReadCountersMessage() const;
-	QByteArray CreateReadParametersMessage() const;
-	QByteArray CreateSingleCycleMessage() const;
-
-	QByteArray CreateWriteCountersMessage(const Counters &) const;
-	QByteArray CreateWriteParametersMessage(const Parameters&) const;
-
-	void AppendCrc(QByteArray&) const;
-	bool CheckCrc(const QByteArray&) const;
-	QByteArray CalculateCrc(const QByteArray&) const;
-	QByteArray ExtractBody(const QByteArray&) const;
-	QByteArray ExtractData(const QByteArray&) const;
-	QByteArray ExtractCrc(const QByteArray&) const;
+	void StartDiscovery(const QStringList& ports);
+	void AttachSerialPort(QSerialPort*);
+	void Disconnect();
+	void HandlePortAdded(const QSerialPortInfo&);
+	void HandlePortRemoved(const QString&);
+
+	void Enqueue(const QByteArray& request,
+				 const QByteArray& reply,
+				 EventCode success,
+				 EventCode error,
+				 std::function<bool(const char*, size_t)> handler = nullptr,
+				 int batch = 0);
+	// Транзакция команды из device-commands.h: кадр, ожидаемый ответ и события
+	// берутся из типа команды, данные ответа разбираются в Command::Response
+	template <class Command>
+	void Execute(const QByteArray& frame,
+				 std::function<void(const typename Command::Response&)> handler = nullptr,
+				 int batch = 0);
+	int NextBatch();
+	bool CanSend(int) const;
+	void SendTransactions();
+	void FinishTransaction(int, const QByteArray&);
+	void FailTransactions(int index, DeviceStats::Outcome);
+	void AbortTransactions();
+	void Poll();
+	void CompletePoll(int source);
+	void HandleReadyRead();
+	void HandleBytesWritten(qint64);
+	void CaptureTraffic(Capture::RecordType, const QByteArray&);
+	void RecordTimings(const Transaction&, qint64 now);
+	int WriteTimeout(qint64 bytes) const;
+	int CycleAllowance() const;
 };
 
 Q_DECLARE_METATYPE(DeviceDriver::EventCode)
 Q_DECLARE_METATYPE(DeviceDriver::Counters)
 Q_DECLARE_METATYPE(DeviceDriver::Parameters)
+Q_DECLARE_METATYPE(DeviceDriver::TelemetrySample)
 
 #endif // DEVICEDRIVER_H
@@ -0,0 +1,367 @@
+#include "device-fleet.h"
+#include "device-discovery.h"
+#include <QSerialPortInfo>
+
+namespace {
+
+bool IsSuccess(DeviceDriver::EventCode event)
+{
+	switch (event) {
+	case DeviceDriver::EventCode::ReadCountersSuccess:
+	case DeviceDriver::EventCode::WriteCountersSuccess:
+	case DeviceDriver::EventCode::ReadParametersSuccess:
+	case DeviceDriver::EventCode::WriteParametersSuccess:
+	case DeviceDriver::EventCode::LaunchSingleCycleSuccess:
+	case DeviceDriver::EventCode::ReadSnapshotSuccess:
+	case DeviceDriver::EventCode::DeviceFound:
+		return true;
+	default:
+		return false;
+	}
+}
+
+// Относится ли событие драйвера к текущей групповой операции
+bool IsOperationEvent(DeviceFleet::Operation operation, DeviceDriver::EventCode event)
+{
+	if (event == DeviceDriver::EventCode::DeviceDisconnected) {
+		return true;
+	}
+
+	switch (operation) {
+	case DeviceFleet::Operation::Discover:
+		return event == DeviceDriver::EventCode::DeviceFound
+				|| event == DeviceDriver::EventCode::DeviceNotFound;
+	case DeviceFleet::Operation::ReadCounters:
+		return event == DeviceDriver::EventCode::ReadCountersSuccess
+				|| event == DeviceDriver::EventCode::ReadCountersError;
+	case DeviceFleet::Operation::ReadParameters:
+		return event == DeviceDriver::EventCode::ReadParametersSuccess
+				|| event == DeviceDriver::EventCode::ReadParametersError;
+	case DeviceFleet::Operation::LaunchSingleCycle:
+		return event == DeviceDriver::EventCode::LaunchSingleCycleSuccess
+				|| event == DeviceDriver::EventCode::LaunchSingleCycleError;
+	case DeviceFleet::Operation::Rollout:
+		return event == DeviceDriver::EventCode::WriteParametersSuccess
+				|| event == DeviceDriver::EventCode::WriteParametersError
+				|| event == DeviceDriver::EventCode::ReadParametersSuccess
+				|| event == DeviceDriver::EventCode::ReadParametersError;
+	case DeviceFleet::Operation::None:
+		break;
+	}
+	return false;
+}
+
+// Поля, прочитанные не такими, как записаны: "tw=120 (expected 100)"
+QStringList CompareParameters(const DeviceDriver::Parameters& expected, const DeviceDriver::Parameters& actual)
+{
+	QStringList result;
+	const auto compare = [&result](const char* name, uint expected, uint actual) {
+		if (expected != actual) {
+			result.append(QString("%1=%2 (expected %3)").arg(name).arg(actual).arg(expected));
+		}
+	};
+	compare("cpm", expected.cpm, actual.cpm);
+	compare("tp", expected.tp, actual.tp);
+	compare("tbc", expected.tbc, actual.tbc);
+	compare("tbtp", expected.tbtp, actual.tbtp);
+	compare("ct", expected.ct, actual.ct);
+	compare("tw", expected.tw, actual.tw);
+	return result;
+}
+
+}
+
+DeviceFleet::DeviceFleet(QObject *parent)
+	: QObject(parent)
+	, _operation(Operation::None)
+{
+	qRegisterMetaType<DeviceFleet::Operation>("DeviceFleet::Operation");
+	qRegisterMetaType<DeviceFleet::Results>("DeviceFleet::Results");
+	qRegisterMetaType<DeviceFleet::RolloutReport>("DeviceFleet::RolloutReport");
+}
+
+DeviceFleet::~DeviceFleet()
+{
+	const auto ports = _members.keys();
+	for (const auto& port : ports) {
+		RemoveMember(port);
+	}
+}
+
+QStringList DeviceFleet::Ports() const
+{
+	QStringList result;
+	for (auto it = _members.cbegin(); it != _members.cend(); ++it) {
+		if (it.value().connected) {
+			result.append(it.key());
+		}
+	}
+	return result;
+}
+
+DeviceStats::Report DeviceFleet::GetStats() const
+{
+	DeviceStats::Report result;
+	for (const auto& member : _members) {
+		DeviceStats::Merge(result, member.driver->GetStats());
+	}
+	return result;
+}
+
+DeviceDriver* DeviceFleet::Device(const QString& port) const
+{
+	const auto it = _members.find(port);
+	return it != _members.end() ? it.value().driver : nullptr;
+}
+
+bool DeviceFleet::IsBusy() const
+{
+	return _operation != Operation::None;
+}
+
+void DeviceFleet::Discover()
+{
+	if (IsBusy()) {
+		return;
+	}
+
+	// Уже подключенные устройства не перепроверяются, отвалившиеся удаляются
+	const auto ports = _members.keys();
+	for (const auto& port : ports) {
+		if (!_members[port].connected) {
+			RemoveMember(port);
+		}
+	}
+
+	_operation = Operation::Discover;
+	_results.clear();
+	_pending.clear();
+	_elapsed.start();
+
+	// Порты симулятора и другие пути вне списка Qt - по пути
+	const auto available_ports = DeviceDiscovery::AvailablePortNames();
+	for (const auto& port : available_ports) {
+		if (_members.contains(port)) {
+			continue;
+		}
+
+		AddMember(port);
+		_pending.insert(port);
+		QMetaObject::invokeMethod(_members[port].driver,
+								  "ConnectPort",
+								  Qt::QueuedConnection,
+								  Q_ARG(QString, port));
+	}
+
+	if (_pending.isEmpty()) {
+		FinishOperation();
+	}
+}
+
+void DeviceFleet::ReadCounters()
+{
+	StartOperation(Operation::ReadCounters, "ReadCounters");
+}
+
+void DeviceFleet::ReadParameters()
+{
+	StartOperation(Operation::ReadParameters, "ReadParameters");
+}
+
+void DeviceFleet::LaunchSingleCycle()
+{
+	StartOperation(Operation::LaunchSingleCycle, "LaunchSingleCycle");
+}
+
+void DeviceFleet::Rollout(const QMap<QString, DeviceDriver::Parameters>& profiles)
+{
+	if (IsBusy()) {
+		return;
+	}
+
+	_operation = Operation::Rollout;
+	_results.clear();
+	_pending.clear();
+	_rollout.clear();
+	_rollout_profiles = profiles;
+	_elapsed.start();
+
+	for (auto it = profiles.cbegin(); it != profiles.cend(); ++it) {
+		const auto member = _members.constFind(it.key());
+		if (member == _members.cend() || !member.value().connected) {
+			_rollout.insert(it.key(), {false, "not connected", {}, 0, 0});
+			continue;
+		}
+
+		_rollout.insert(it.key(), {false, QString(), {}, 0, 0});
+		_pending.insert(it.key());
+		DeviceDriver* driver = member.value().driver;
+		const DeviceDriver::Parameters parameters = it.value();
+		QMetaObject::invokeMethod(driver, [driver, parameters]() {
+			driver->WriteParameters(parameters);
+		}, Qt::QueuedConnection);
+	}
+
+	if (_pending.isEmpty()) {
+		FinishOperation();
+	}
+}
+
+void DeviceFleet::RolloutProfile(const DeviceDriver::Parameters& parameters)
+{
+	QMap<QString, DeviceDriver::Parameters> profiles;
+	const auto ports = Ports();
+	for (const auto& port : ports) {
+		profiles.insert(port, parameters);
+	}
+	Rollout(profiles);
+}
+
+void DeviceFleet::AddMember(const QString& port)
+{
+	Member member = {new DeviceDriver, new QThread(this), false};
+
+	connect(member.driver, &DeviceDriver::Event, this,
+			[this, port](DeviceDriver::EventCode event) { HandleEvent(port, event); });
+	connect(member.driver, &DeviceDriver::Trace, this,
+			[this, port](const QString& text) { emit Trace(port, text); });
+	connect(member.driver, &DeviceDriver::TraceFrame, this,
+			[this, port](Tracing::Direction direction, const QByteArray& frame) {
+		emit TraceFrame(port, direction, frame);
+	});
+	connect(member.thread, &QThread::finished, member.driver, &QObject::deleteLater);
+
+	member.driver->moveToThread(member.thread);
+	member.thread->start();
+	_members.insert(port, member);
+}
+
+void DeviceFleet::RemoveMember(const QString& port)
+{
+	const Member member = _members.take(port);
+	member.driver->disconnect(this);
+	member.thread->quit();
+	member.thread->wait();
+	member.thread->deleteLater();
+	_pending.remove(port);
+}
+
+void DeviceFleet::StartOperation(Operation operation, const char* slot)
+{
+	if (IsBusy()) {
+		return;
+	}
+
+	_operation = operation;
+	_results.clear();
+	_pending.clear();
+	_elapsed.start();
+
+	for (auto it = _members.begin(); it != _members.end(); ++it) {
+		if (it.value().connected) {
+			_pending.insert(it.key());
+			QMetaObject::invokeMethod(it.value().driver, slot, Qt::QueuedConnection);
+		}
+	}
+
+	if (_pending.isEmpty()) {
+		FinishOperation();
+	}
+}
+
+void DeviceFleet::HandleEvent(const QString& port, DeviceDriver::EventCode event)
+{
+	auto it = _members.find(port);
+	if (it == _members.end()) {
+		return;
+	}
+
+	// Связь меняют только подключение и отключение. Ошибка обмена закрывает
+	// порт в драйвере, а отказ без обмена (неверные параметры) и события
+	// телеметрии - нет, поэтому для прочих событий спрашиваем драйвер
+	switch (event) {
+	case DeviceDriver::EventCode::DeviceFound:
+		it.value().connected = true;
+		break;
+	case DeviceDriver::EventCode::DeviceNotFound:
+	case DeviceDriver::EventCode::DeviceDisconnected:
+		it.value().connected = false;
+		break;
+	default:
+		it.value().connected = it.value().driver->IsConnected();
+		break;
+	}
+	emit DeviceEvent(port, event);
+
+	if (_pending.contains(port) && IsOperationEvent(_operation, event)) {
+		if (_operation == Operation::Rollout && !HandleRolloutEvent(port, event)) {
+			return;
+		}
+		_pending.remove(port);
+		_results.insert(port, event);
+		if (_pending.isEmpty()) {
+			FinishOperation();
+		}
+	}
+}
+
+bool DeviceFleet::HandleRolloutEvent(const QString& port, DeviceDriver::EventCode event)
+{
+	auto& result = _rollout[port];
+
+	switch (event) {
+	// Запись подтверждена, параметры перечитываются из устройства, не из кэша
+	case DeviceDriver::EventCode::WriteParametersSuccess: {
+		result.write_ms = _elapsed.elapsed();
+		DeviceDriver* driver = _members[port].driver;
+		QMetaObject::invokeMethod(driver, [driver]() {
+			driver->InvalidateCache();
+			driver->ReadParameters();
+		}, Qt::QueuedConnection);
+		return false;
+	}
+
+	case DeviceDriver::EventCode::ReadParametersSuccess:
+		result.verify_ms = _elapsed.elapsed() - result.write_ms;
+		result.mismatches = CompareParameters(_rollout_profiles.value(port),
+											  _members[port].driver->GetParameters());
+		result.passed = result.mismatches.isEmpty();
+		if (!result.passed) {
+			result.error = "verify";
+		}
+		return true;
+
+	case DeviceDriver::EventCode::WriteParametersError:
+		result.error = "write";
+		return true;
+
+	case DeviceDriver::EventCode::ReadParametersError:
+		result.error = "read back";
+		return true;
+
+	default:
+		result.error = "disconnected";
+		return true;
+	}
+}
+
+void DeviceFleet::FinishOperation()
+{
+	const Operation operation = _operation;
+	_operation = Operation::None;
+
+	// Порты без устройства больше не держат поток
+	if (operation == Operation::Discover) {
+		for (auto it = _results.cbegin(); it != _results.cend(); ++it) {
+			if (!IsSuccess(it.value())) {
+				RemoveMember(it.key());
+			}
+		}
+	}
+
+	const qint64 elapsed = _elapsed.elapsed();
+	emit OperationFinished(operation, _results, elapsed);
+	if (operation == Operation::Rollout) {
+		emit RolloutFinished(_rollout, elapsed);
+	}
+}
@@ -0,0 +1,108 @@
+#ifndef DEVICEFLEET_H
+#define DEVICEFLEET_H
+
+#include "device-driver.h"
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QThread>
+#include <QMap>
+#include <QSet>
+#include <QStringList>
+
+// Группа устройств на одном хосте: по драйверу и потоку на каждый порт.
+// Групповые операции запускаются на всех устройствах одновременно,
+// поэтому занимают время одного обмена, а не N обменов.
+class DeviceFleet : public QObject
+{
+	Q_OBJECT
+
+public:
+	enum class Operation {
+		None,
+		Discover,
+		ReadCounters,
+		ReadParameters,
+		LaunchSingleCycle,
+		Rollout
+	};
+
+	// Итог операции по каждому порту
+	typedef QMap<QString, DeviceDriver::EventCode> Results;
+
+	// Итог записи параметров на одно устройство
+	struct RolloutResult {
+		bool passed;
+		QString error; // этап, на котором произошёл сбой
+		QStringList mismatches; // поля, прочитанные не такими, как записаны
+		qint64 write_ms; // от начала операции до подтверждения записи
+		qint64 verify_ms; // чтение для проверки
+	};
+	typedef QMap<QString, RolloutResult> RolloutReport;
+
+public:
+	explicit DeviceFleet(QObject *parent = nullptr);
+	~DeviceFleet();
+
+	QStringList Ports() const;
+	DeviceDriver* Device(const QString&) const;
+	bool IsBusy() const;
+
+	// Статистика обмена всех устройств группы
+	DeviceStats::Report GetStats() const;
+
+public slots:
+	void Discover();
+
+	void ReadCounters();
+	void ReadParameters();
+	void LaunchSingleCycle();
+
+	// Запись параметров на все устройства одновременно с проверкой чтением.
+	// Устройства из profiles, которых нет среди подключенных, сразу
+	// получают отказ; сбой одного устройства не задерживает остальные
+	void Rollout(const QMap<QString, DeviceDriver::Parameters>& profiles);
+	// Один профиль для всех подключенных устройств
+	void RolloutProfile(const DeviceDriver::Parameters&);
+
+signals:
+	void DeviceEvent(const QString& port, DeviceDriver::EventCode);
+	void OperationFinished(DeviceFleet::Operation, const DeviceFleet::Results&, qint64 elapsed_ms);
+	void Trace(const QString& port, const QString&);
+	void TraceFrame(const QString& port, Tracing::Direction, const QByteArray&);
+	// После OperationFinished(Rollout, ...)
+	void RolloutFinished(const DeviceFleet::RolloutReport&, qint64 elapsed_ms);
+
+private:
+	struct Member {
+		DeviceDriver* driver;
+		QThread* thread;
+		bool connected;
+	};
+
+	QMap<QString, Member> _members;
+
+	Operation _operation;
+	QSet<QString> _pending;
+	Results _results;
+	QElapsedTimer _elapsed;
+
+	// Записываемые параметры и ход проверки по портам
+	QMap<QString, DeviceDriver::Parameters> _rollout_profiles;
+	RolloutReport _rollout;
+
+private:
+	void AddMember(const QString&);
+	void RemoveMember(const QString&);
+	void StartOperation(Operation, const char* slot);
+	void HandleEvent(const QString&, DeviceDriver::EventCode);
+	// true - проверка устройства закончена
+	bool HandleRolloutEvent(const QString&, DeviceDriver::EventCode);
+	void FinishOperation();
+};
+
+Q_DECLARE_METATYPE(DeviceFleet::Operation)
+Q_DECLARE_METATYPE(DeviceFleet::Results)
+Q_DECLARE_METATYPE(DeviceFleet::RolloutReport)
+
+#endif // DEVICEFLEET_H
@@ -0,0 +1,76 @@
+#include "device-stats.h"
+#include <QMutexLocker>
+
+void DeviceStats::RecordLatency(const QString& port, const QString& command, Stage stage, qint64 us)
+{
+	QMutexLocker lock(&_mutex);
+	_report[port].commands[command].stages[stage].Record(static_cast<uint64_t>(qMax<qint64>(0, us)));
+}
+
+void DeviceStats::RecordOutcome(const QString& port, const QString& command, Outcome outcome)
+{
+	QMutexLocker lock(&_mutex);
+	++_report[port].commands[command].outcomes[outcome];
+}
+
+void DeviceStats::RecordDisconnect(const QString& port)
+{
+	QMutexLocker lock(&_mutex);
+	++_report[port].disconnects;
+}
+
+DeviceStats::Report DeviceStats::Snapshot() const
+{
+	QMutexLocker lock(&_mutex);
+	return _report;
+}
+
+void DeviceStats::Reset()
+{
+	QMutexLocker lock(&_mutex);
+	_report.clear();
+}
+
+void DeviceStats::Merge(Report& into, const Report& from)
+{
+	for (auto port = from.cbegin(); port != from.cend(); ++port) {
+		auto& target = into[port.key()];
+		target.disconnects += port->disconnects;
+
+		for (auto command = port->commands.cbegin(); command != port->commands.cend(); ++command) {
+			auto& stats = target.commands[command.key()];
+			for (int i = 0; i < StageCount; ++i) {
+				stats.stages[i].Merge(command->stages[i]);
+			}
+			for (int i = 0; i < OutcomeCount; ++i) {
+				stats.outcomes[i] += command->outcomes[i];
+			}
+		}
+	}
+}
+
+QString DeviceStats::StageName(Stage stage)
+{
+	switch (stage) {
+	case QueueWait: return "queue";
+	case WriteDone: return "write";
+	case FirstByte: return "first byte";
+	case FullFrame: return "frame";
+	case StageCount: break;
+	}
+	return QString();
+}
+
+QString DeviceStats::OutcomeName(Outcome outcome)
+{
+	switch (outcome) {
+	case Success: return "ok";
+	case CrcError: return "crc";
+	case Timeout: return "timeout";
+	case WriteError: return "write error";
+	case Malformed: return "malformed";
+	case Aborted: return "aborted";
+	case OutcomeCount: break;
+	}
+	return QString();
+}
@@ -0,0 +1,64 @@
+#ifndef DEVICESTATS_H
+#define DEVICESTATS_H
+
+#include <QMap>
+#include <QMutex>
+#include <QString>
+
+#include "latency-histogram.h"
+
+// Статистика обмена по портам и командам: гистограммы задержек этапов
+// транзакции (мкс) и счётчики исходов. Пишет поток драйвера, читать
+// снимок можно из любого потока.
+class DeviceStats
+{
+public:
+	// Этапы транзакции: ожидание в очереди отсчитывается от постановки,
+	// остальные - от отправки запроса
+	enum Stage {
+		QueueWait,
+		WriteDone,
+		FirstByte,
+		FullFrame,
+		StageCount
+	};
+
+	enum Outcome {
+		Success,
+		CrcError,
+		Timeout,
+		WriteError,
+		Malformed, // CRC верен, но данные ответа не разбираются
+		Aborted, // снята из-за ошибки другой транзакции
+		OutcomeCount
+	};
+
+	struct Command {
+		LatencyHistogram stages[StageCount];
+		quint64 outcomes[OutcomeCount] = {};
+	};
+
+	struct Port {
+		quint64 disconnects = 0;
+		QMap<QString, Command> commands;
+	};
+
+	typedef QMap<QString, Port> Report;
+
+	void RecordLatency(const QString& port, const QString& command, Stage, qint64 us);
+	void RecordOutcome(const QString& port, const QString& command, Outcome);
+	void RecordDisconnect(const QString& port);
+
+	Report Snapshot() const;
+	void Reset();
+
+	static void Merge(Report& into, const Report& from);
+	static QString StageName(Stage);
+	static QString OutcomeName(Outcome);
+
+private:
+	mutable QMutex _mutex;
+	Report _report;
+};
+
+#endif // DEVICESTATS_H
@@ -0,0 +1,83 @@
+#ifndef FIELDCACHE_H
+#define FIELDCACHE_H
+
+#include <array>
+#include <cstdint>
+
+// Последние подтверждённые устройством значения структуры по полям.
+// Поле известно (Clean), если его прочитали или устройство подтвердило
+// запись; Dirty - запись отправлена, но ещё не подтверждена.
+template <int N>
+class FieldCache
+{
+public:
+	typedef std::array<uint32_t, N> Values;
+
+	enum class State {
+		Unknown,
+		Clean,
+		Dirty
+	};
+
+	FieldCache()
+	{
+		Invalidate();
+	}
+
+	// Значения прочитаны или запись подтверждена; now_ns - время по часам драйвера
+	void Confirm(const Values& values, int64_t now_ns)
+	{
+		_values = values;
+		_states.fill(State::Clean);
+		_confirmed_ns.fill(now_ns);
+	}
+
+	// Отправлена запись: поля с другими значениями больше не известны точно
+	void MarkDirty(const Values& values)
+	{
+		for (int i = 0; i < N; ++i) {
+			if (_states[i] != State::Clean || _values[i] != values[i]) {
+				_states[i] = State::Dirty;
+			}
+		}
+	}
+
+	void Invalidate()
+	{
+		_values.fill(0);
+		_states.fill(State::Unknown);
+		_confirmed_ns.fill(0);
+	}
+
+	// Все поля известны и совпадают: запись ничего не изменит
+	bool Matches(const Values& values) const
+	{
+		for (int i = 0; i < N; ++i) {
+			if (_states[i] != State::Clean || _values[i] != values[i]) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// Все поля известны и подтверждены не раньше window_ns назад
+	bool IsFresh(int64_t now_ns, int64_t window_ns) const
+	{
+		for (int i = 0; i < N; ++i) {
+			if (_states[i] != State::Clean || now_ns - _confirmed_ns[i] > window_ns) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	State FieldState(int field) const { return _states[field]; }
+	int64_t ConfirmedAt(int field) const { return _confirmed_ns[field]; }
+
+private:
+	Values _values;
+	std::array<State, N> _states;
+	std::array<int64_t, N> _confirmed_ns;
+};
+
+#endif // FIELDCACHE_H
@@ -0,0 +1,37 @@
+#include "frame-parser.h"
+
+FrameParser::FrameParser()
+{
+	Reset();
+}
+
+void FrameParser::Append(const QByteArray& data, qint64 time)
+{
+	for (const char c : data) {
+		if (c == Protocol::kReplyStart) {
+			_started = time;
+		}
+		if (_assembler.Push(c)) {
+			_frames.enqueue({QByteArray(_assembler.Frame(), static_cast<int>(_assembler.Size())),
+							 _assembler.CrcOk(),
+							 _started});
+		}
+	}
+}
+
+bool FrameParser::HasFrame() const
+{
+	return !_frames.isEmpty();
+}
+
+FrameParser::Frame FrameParser::TakeFrame()
+{
+	return _frames.dequeue();
+}
+
+void FrameParser::Reset()
+{
+	_assembler.Reset();
+	_frames.clear();
+	_started = 0;
+}
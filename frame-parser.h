@@ -0,0 +1,36 @@
+#ifndef FRAMEPARSER_H
+#define FRAMEPARSER_H
+
+#include "frame-codec.h"
+
+#include <QByteArray>
+#include <QQueue>
+
+// Потоковая сборка кадров "$<данные><CRC>\r\n" из произвольных кусков,
+// приходящих из порта. Кадр может прийти частями, несколько кадров -
+// одним куском. Сборка и CRC - Protocol::FrameAssembler, здесь только
+// очередь готовых кадров в QByteArray.
+class FrameParser
+{
+public:
+	struct Frame {
+		QByteArray raw; // кадр целиком, включая '$' и "\r\n"
+		bool crc_ok;
+		qint64 started; // отметка прихода куска с началом кадра '$'
+	};
+
+	FrameParser();
+
+	// time - отметка прихода куска, переходит в Frame::started
+	void Append(const QByteArray&, qint64 time = 0);
+	bool HasFrame() const;
+	Frame TakeFrame();
+	void Reset();
+
+private:
+	Protocol::FrameAssembler _assembler;
+	QQueue<Frame> _frames;
+	qint64 _started; // начало недособранного кадра
+};
+
+#endif // FRAMEPARSER_H
@@ -0,0 +1,104 @@
+#ifndef LATENCYHISTOGRAM_H
+#define LATENCYHISTOGRAM_H
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+
+// Гистограмма задержек в духе HDR: диапазоны по степеням двойки, каждый
+// поделён на 32 равных ведра. Относительная погрешность не больше 1/32
+// во всём диапазоне, размер фиксирован, запись - O(1) без выделений.
+class LatencyHistogram
+{
+public:
+	static constexpr int kSubBits = 5;
+	static constexpr int kSubBuckets = 1 << kSubBits;
+	static constexpr int kMaxBit = 31; // значения больше 2^32 - 1 обрезаются
+	static constexpr int kBuckets = (kMaxBit - kSubBits + 2) * kSubBuckets;
+
+	LatencyHistogram()
+	{
+		Reset();
+	}
+
+	void Reset()
+	{
+		_buckets.fill(0);
+		_count = 0;
+		_min = 0;
+		_max = 0;
+	}
+
+	void Record(uint64_t value)
+	{
+		value = std::min<uint64_t>(value, UINT32_MAX);
+		++_buckets[Index(value)];
+		_min = _count ? std::min(_min, value) : value;
+		_max = std::max(_max, value);
+		++_count;
+	}
+
+	void Merge(const LatencyHistogram& other)
+	{
+		for (int i = 0; i < kBuckets; ++i) {
+			_buckets[i] += other._buckets[i];
+		}
+		if (other._count) {
+			_min = _count ? std::min(_min, other._min) : other._min;
+			_max = std::max(_max, other._max);
+		}
+		_count += other._count;
+	}
+
+	uint64_t Count() const { return _count; }
+	uint64_t Min() const { return _min; }
+	uint64_t Max() const { return _max; }
+
+	// Верхняя граница ведра, в которое попадает percentile [0 .. 100]
+	uint64_t Percentile(double percentile) const
+	{
+		if (!_count) {
+			return 0;
+		}
+		const double clamped = std::min(100.0, std::max(0.0, percentile));
+		const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(clamped / 100.0 * _count + 0.5));
+
+		uint64_t seen = 0;
+		for (int i = 0; i < kBuckets; ++i) {
+			seen += _buckets[i];
+			if (seen >= rank) {
+				return std::min(UpperBound(i), _max);
+			}
+		}
+		return _max;
+	}
+
+private:
+	std::array<uint32_t, kBuckets> _buckets;
+	uint64_t _count;
+	uint64_t _min;
+	uint64_t _max;
+
+private:
+	static int Index(uint64_t value)
+	{
+		if (value < static_cast<uint64_t>(kSubBuckets)) {
+			return static_cast<int>(value);
+		}
+		const int bit = 63 - __builtin_clzll(value);
+		const int shift = bit - kSubBits;
+		return (shift + 1) * kSubBuckets + static_cast<int>((value >> shift) - kSubBuckets);
+	}
+
+	static uint64_t UpperBound(int index)
+	{
+		if (index < kSubBuckets) {
+			return static_cast<uint64_t>(index);
+		}
+		const int shift = index / kSubBuckets - 1;
+		const uint64_t sub = static_cast<uint64_t>(index % kSubBuckets + kSubBuckets);
+		return ((sub + 1) << shift) - 1;
+	}
+};
+
+#endif // LATENCYHISTOGRAM_H
@@ -1,11 +1,24 @@
 #include "mainwindow.h"
 
 #include <QApplication>
+#include <QCommandLineParser>
 
 int main(int argc, char *argv[])
 {
 	QApplication a(argc, argv);
+	QApplication::setOrganizationName("Archipelago");
+	QApplication::setApplicationName("archipelago");
+
+	QCommandLineParser parser;
+	parser.addHelpOption();
+	QCommandLineOption capture_option("capture", "Record serial traffic to <file>.", "file");
+	parser.addOption(capture_option);
+	parser.process(a);
+
 	MainWindow w;
+	if (parser.isSet(capture_option)) {
+		w.StartCapture(parser.value(capture_option));
+	}
 	w.setWindowFlags(Qt::FramelessWindowHint| Qt::WindowSystemMenuHint);
 	w.show();
 	return a.exec();
@@ -14,6 +14,7 @@
 #include <QShortcut>
 #include <QDesktopWidget>
 #include <QFontDatabase>
+#include <QScrollBar>
 
 MainWindow::MainWindow(QWidget *parent)
 	: QMainWindow(parent)
@@ -28,12 +29,14 @@ MainWindow::MainWindow(QWidget *parent)
 	, about(new QWidget)
 	, info(new QWidget)
 	, terminal(new QWidget)
-	, current_state(State::Initial)
 	, device_driver()
 	, device_driver_thread()
-	, local_counters({})
-	, local_parameters({})
-	, local_characteristics({})
+	, controller(&device_driver)
+	, stats_panel(new StatsPanel([this]() { return device_driver.GetStats(); },
+								 [this]() { device_driver.ResetStats(); }))
+	, trace_model(new TraceModel(10000, this))
+	, trace_follow(true)
+	, telemetry_timer(new QTimer(this))
 	, admin_mode(false)
 {
 	ui->setupUi(this);
@@ -43,21 +46,38 @@ MainWindow::MainWindow(QWidget *parent)
 	ui_about->setupUi(about);
 	ui_info->setupUi(info);
 	ui_terminal->setupUi(terminal);
+	terminal->installEventFilter(this);
+
+	// Журнал: строки видны только в пределах окна, пачка вставляется раз в кадр
+	ui_terminal->terminal->setModel(trace_model);
+	connect(trace_model, &TraceModel::rowsAboutToBeInserted, this, [this]() {
+		const auto scroll = ui_terminal->terminal->verticalScrollBar();
+		trace_follow = scroll->value() == scroll->maximum();
+	});
+	connect(trace_model, &TraceModel::rowsInserted, this, [this]() {
+		if (trace_follow) {
+			ui_terminal->terminal->scrollToBottom();
+		}
+	});
 
 
 	// Драйвер устройства
-	connect(this, &MainWindow::FindDevice, &device_driver, &DeviceDriver::FindDevice);
-	connect(this, &MainWindow::ReadCounters, &device_driver, &DeviceDriver::ReadCounters);
-	connect(this, &MainWindow::WriteCounters, &device_driver, &DeviceDriver::WriteCounters);
-	connect(this, &MainWindow::ReadParameters, &device_driver, &DeviceDriver::ReadParameters);
-	connect(this, &MainWindow::WriteParameters, &device_driver, &DeviceDriver::WriteParameters);
-	connect(this, &MainWindow::LaunchSingleCycle, &device_driver, &DeviceDriver::LaunchSingleCycle);
-
-	connect(&device_driver, &DeviceDriver::Event, this, &MainWindow::Event);
 	connect(&device_driver, &DeviceDriver::Trace, this, &MainWindow::TerminalTrace);
+	connect(&device_driver, &DeviceDriver::TraceFrame, this, &MainWindow::TerminalFrame);
+
+	connect(&controller, &ConnectionController::Progress, this, &MainWindow::ShowLoading);
+	connect(&controller, &ConnectionController::Notice, this, &MainWindow::ShowInfo);
+	connect(&controller, &ConnectionController::SnapshotUpdated, this, &MainWindow::ShowProcess);
+	connect(&controller, &ConnectionController::CharacteristicsUpdated, this, &MainWindow::ShowCharacteristics);
+	connect(&controller, &ConnectionController::Trace, this, &MainWindow::TerminalTrace);
+
+	// Отсчёты фонового опроса забираются по таймеру, поток драйвера не ждёт окно
+	telemetry_timer->setInterval(100);
+	connect(telemetry_timer, &QTimer::timeout, this, &MainWindow::ShowTelemetry);
 
 	device_driver.moveToThread(&device_driver_thread);
 	device_driver_thread.start();
+	QMetaObject::invokeMethod(&device_driver, [this]() { device_driver.SetHotPlug(true); });
 
 	// Графика
 	connect(ui->button_close, &QPushButton::clicked, this , &MainWindow::CloseButton);
@@ -66,7 +86,6 @@ MainWindow::MainWindow(QWidget *parent)
 	connect(ui_process->button_single_cycle, &QPushButton::clicked, this, &MainWindow::SingleCycleButton);
 	connect(ui_process->button_write_data, &QPushButton::clicked, this, &MainWindow::WriteParametersButton);
 	connect(ui_process->button_write_counters, &QPushButton::clicked, this, &MainWindow::WriteCountersButton);
-	connect(this, &MainWindow::Trace, this, &MainWindow::TerminalTrace);
 
 
 	QMovie* movie = new QMovie(":/logo/load.gif");
@@ -88,6 +107,12 @@ MainWindow::MainWindow(QWidget *parent)
 	QShortcut* term = new QShortcut(QKeySequence("Ctrl+Alt+T"), this);
 	connect(term, &QShortcut::activated, this, &MainWindow::ShowTerminal);
 
+	QShortcut* stats = new QShortcut(QKeySequence("Ctrl+Alt+S"), this);
+	connect(stats, &QShortcut::activated, this, &MainWindow::ShowStats);
+
+	QShortcut* poll = new QShortcut(QKeySequence("Ctrl+Alt+P"), this);
+	connect(poll, &QShortcut::activated, this, &MainWindow::SwitchPolling);
+
 	QFontDatabase::addApplicationFont(":/text/AT_Avant.ttf");
 	QFont font = QFont("AT Avant");
 	QApplication::setFont(font);
@@ -96,11 +121,28 @@ MainWindow::MainWindow(QWidget *parent)
 
 MainWindow::~MainWindow()
 {
+	// Драйвер удаляется в потоке окна, его таймеры и порт - в своём потоке
+	QMetaObject::invokeMethod(&device_driver, [this]() { device_driver.Close(); },
+							  Qt::BlockingQueuedConnection);
 	device_driver_thread.quit();
 	device_driver_thread.wait();
+	device_driver.SetCapture(nullptr);
+	delete stats_panel;
+	capture_writer.Close();
 	delete ui;
 }
 
+bool MainWindow::StartCapture(const QString& path)
+{
+	if (!capture_writer.Open(path.toStdString())) {
+		TerminalTrace("capture error : " + path);
+		return false;
+	}
+	device_driver.SetCapture(&capture_writer);
+	TerminalTrace("capture -> " + path);
+	return true;
+}
+
 void MainWindow::mousePressEvent(QMouseEvent* event)
 {
 	m_nMouseClick_X_Coordinate = event->x();
@@ -166,7 +208,7 @@ void MainWindow::ShowAbout()
 {
 	EnableButtons(true);
 
-	if (current_state == State::Ready) {
+	if (controller.CurrentState() == ConnectionController::State::Ready) {
 		ui->button_connect->setText("Обновить данные");
 		ui->button_about->setText("Назад");
 	} else {
@@ -205,13 +247,47 @@ void MainWindow::ShowProcess()
 	move(rect.topLeft());
 }
 
+void MainWindow::ShowCharacteristics()
+{
+	const auto characteristics = controller.GetCharacteristics();
+	QString curr_str = QString::number(characteristics.curr * Protocol::kCurrentScale) + " А";
+	QString vlt_str = QString::number(characteristics.vlt * Protocol::kVoltageScale) + " В";
+	QString message = QString("Успешно.<br>Ток насоса = ")
+			+ curr_str
+			+ "<br>Напряжение питания = "
+			+ vlt_str;
+	ShowInfo(message);
+
+	ui_process->vlt_label->setText(vlt_str);
+	ui_process->curr_label->setText(curr_str);
+}
+
 void MainWindow::ShowTerminal()
 {
+	// Подробная трассировка нужна только при открытом терминале
+	Tracing::SetLevel(Tracing::Level::Debug);
 	terminal->show();
 }
 
+void MainWindow::ShowStats()
+{
+	stats_panel->show();
+	stats_panel->raise();
+}
+
+bool MainWindow::eventFilter(QObject *watched, QEvent *event)
+{
+	if (watched == terminal && event->type() == QEvent::Hide) {
+		Tracing::SetLevel(Tracing::Level::Warning);
+	}
+	return QMainWindow::eventFilter(watched, event);
+}
+
 void MainWindow::WriteValuesToWindow()
 {
+	const auto local_counters = controller.GetCounters();
+	const auto local_parameters = controller.GetParameters();
+
 	ui_process->cycles_label->setText(QString::number(local_counters.cycles));
 	ui_process->cycles_edit->setValue(local_counters.cycles);
 
@@ -270,6 +346,40 @@ QString MainWindow::FormatSeconds(unsigned long input_seconds)
 	return result;
 }
 
+void MainWindow::SwitchPolling()
+{
+	controller.SetPolling(!controller.IsPolling());
+	if (controller.IsPolling()) {
+		telemetry_timer->start();
+		TerminalTrace("Polling started");
+	} else {
+		telemetry_timer->stop();
+		TerminalTrace("Polling stopped");
+	}
+}
+
+void MainWindow::ShowTelemetry()
+{
+	telemetry_samples.clear();
+	if (!device_driver.DrainTelemetry(telemetry_samples)) {
+		if (!controller.IsPolling()) {
+			telemetry_timer->stop();
+		}
+		return;
+	}
+
+	// На экран выводится только последний отсчёт
+	const auto& sample = telemetry_samples.last();
+	if (sample.sources & DeviceDriver::TelemetryCounters) {
+		ui_process->cycles_label->setText(QString::number(sample.counters.cycles));
+		ui_process->time_label->setText(FormatSeconds(sample.counters.time));
+	}
+	if (sample.sources & DeviceDriver::TelemetrySingleCycle) {
+		ui_process->vlt_label->setText(QString::number(sample.characteristics.vlt * Protocol::kVoltageScale) + " В");
+		ui_process->curr_label->setText(QString::number(sample.characteristics.curr * Protocol::kCurrentScale) + " А");
+	}
+}
+
 void MainWindow::EnableButtons(bool value)
 {
 	ui->button_connect->setEnabled(value);
@@ -278,13 +388,15 @@ void MainWindow::EnableButtons(bool value)
 
 void MainWindow::RefreshWindow()
 {
-	if (current_state == State::Initial) {
+	const auto state = controller.CurrentState();
+	if (state == ConnectionController::State::Initial) {
 		ShowInitial();
-	} else if (current_state == State::Ready) {
-		ShowProcess();
-	} else if (current_state == State::ReadCounters) {
-		ShowLoading("Чтение счётчиков...");
-		emit ReadCounters();
+	} else if (state == ConnectionController::State::Ready) {
+		if (controller.IsRefreshPending()) {
+			controller.Refresh();
+		} else {
+			ShowProcess();
+		}
 	}
 }
 
@@ -295,23 +407,13 @@ void MainWindow::CloseButton()
 
 void MainWindow::ConnectButton()
 {
-	if (!device_driver.IsConnected() || current_state == State::Initial) {
-		ShowLoading("Поиск устройства...");
-		current_state = State::Connect;
-		emit FindDevice();
-	}
-
-	if (current_state == State::Ready) {
-		ShowLoading("Чтение счётчиков...");
-		current_state = State::ReadCounters;
-		emit ReadCounters();
-	}
+	controller.Connect();
 }
 
 void MainWindow::AboutButton()
 {
 	if (about->isVisible()) {
-		if (current_state == State::Ready) {
+		if (controller.CurrentState() == ConnectionController::State::Ready) {
 			ShowProcess();
 		}
 	} else {
@@ -321,26 +423,19 @@ void MainWindow::AboutButton()
 
 void MainWindow::SingleCycleButton()
 {
-	ShowLoading("Однократный пуск цикла...");
-
-	current_state = State::LaunchSingleCycle;
-	emit LaunchSingleCycle();
+	controller.LaunchSingleCycle();
 }
 
 void MainWindow::WriteParametersButton()
 {
 	ReadValuesFromControls();
-	ShowLoading("Передача параметров...");
-	current_state = State::WriteParameters;
-	emit WriteParameters(tmp_parameters);
+	controller.WriteParameters(tmp_parameters);
 }
 
 void MainWindow::WriteCountersButton()
 {
 	ReadValuesFromControls();
-	ShowLoading("Передача счетчиков...");
-	current_state = State::WriteCounters;
-	emit WriteCounters(tmp_counters);
+	controller.WriteCounters(tmp_counters);
 }
 
 void MainWindow::SwitchToAdminMode()
@@ -349,161 +444,6 @@ void MainWindow::SwitchToAdminMode()
 	RefreshWindow();
 }
 
-void MainWindow::Event(DeviceDriver::EventCode event)
-{
-	static const unsigned int kMaxRetryReadNumber = 2;
-	static unsigned int retry_read_number = 0;
-	QThread::msleep(200);
-
-	if (event == DeviceDriver::EventCode::DeviceDisconnected) {
-		current_state = State::Initial;
-		ShowInfo("Подключение прервано :(");
-		retry_read_number = 0;
-		return;
-	}
-
-	switch (current_state) {
-	case State::Initial: break;
-
-
-	case State::Connect: {
-		if (event == DeviceDriver::EventCode::DeviceFound)
-		{
-			retry_read_number = 0;
-			current_state = State::ReadCounters;
-			ShowLoading("Чтение счётчиков...");
-			emit ReadCounters();
-		}
-		else if (event == DeviceDriver::EventCode::DeviceNotFound)
-		{
-			if (retry_read_number < kMaxRetryReadNumber) {
-				++retry_read_number;
-				emit Trace(QString("Retry connect №") + QString::number(retry_read_number));
-				ShowLoading("Попытка переподключения...");
-				current_state = State::Connect;
-				emit FindDevice();
-			} else {
-				retry_read_number = 0;
-				current_state = State::Initial;
-				ShowInfo("Устройство не найдено :(");
-				emit Trace("EventCode::DeviceNotFound\n");
-			}
-		}
-	}
-		break;
-
-
-	case State::ReadCounters: {
-		if (event == DeviceDriver::EventCode::ReadCountersSuccess)
-		{
-			retry_read_number = 0;
-			local_counters = device_driver.GetCounters();
-			current_state = State::ReadParameters;
-			ShowLoading("Чтение параметров...");
-			emit ReadParameters();
-		}
-		else if (event == DeviceDriver::EventCode::ReadCountersError)
-		{
-			if (retry_read_number < kMaxRetryReadNumber) {
-				++retry_read_number;
-				emit Trace(QString("Retry connect №") + QString::number(retry_read_number));
-				ShowLoading("Попытка переподключения...");
-				current_state = State::Connect;
-				emit FindDevice();
-			} else {
-				retry_read_number = 0;
-				current_state = State::Initial;
-				ShowInfo("Ошибка чтения значений счётчиков :(");
-				emit Trace("EventCode::ReadCountersError\n");
-			}
-		}
-	}
-		break;
-
-
-	case State::ReadParameters: {
-		if (event == DeviceDriver::EventCode::ReadParametersSuccess)
-		{
-			retry_read_number = 0;
-			local_parameters = device_driver.GetParameters();
-			current_state = State::Ready;
-			ShowProcess();
-		}
-		else if (event == DeviceDriver::EventCode::ReadParametersError)
-		{
-			if (retry_read_number < kMaxRetryReadNumber) {
-				++retry_read_number;
-				emit Trace(QString("Retry connect №") + QString::number(retry_read_number));
-				ShowLoading("Попытка переподключения...");
-				current_state = State::Connect;
-				emit FindDevice();
-			} else {
-				retry_read_number = 0;
-				current_state = State::Initial;
-				ShowInfo("Ошибка чтения значений параметров :(");
-				emit Trace("EventCode::ReadParametersError\n");
-			}
-		}
-	}
-		break;
-	case State::WriteCounters: {
-		if (event == DeviceDriver::EventCode::WriteCountersSuccess)
-		{
-			current_state = State::ReadCounters;
-			ShowInfo("Успешно!");
-		}
-		else if (event == DeviceDriver::EventCode::WriteCountersError)
-		{
-			current_state = State::Ready;
-			ShowInfo("Ошибка передачи счётчиков :(");
-			emit Trace("EventCode::WriteCountersError\n");
-		}
-	}
-		break;
-	case State::WriteParameters:
-	{
-			if (event == DeviceDriver::EventCode::WriteParametersSuccess)
-			{
-				current_state = State::ReadCounters;
-				ShowInfo("Успешно!");
-			}
-			else if (event == DeviceDriver::EventCode::WriteParametersError)
-			{
-				current_state = State::Ready;
-				ShowInfo("Ошибка передачи параметров :(");
-				emit Trace("EventCode::WriteCountersError\n");
-			}
-		}
-		break;
-	case State::LaunchSingleCycle: {
-		if (event == DeviceDriver::EventCode::LaunchSingleCycleSuccess)
-		{
-			local_characteristics = device_driver.GetCharacteristics();
-			current_state = State::Ready;
-			QString curr_str = QString::number(local_characteristics.curr * 0.001) + " А";
-			QString vlt_str = QString::number(local_characteristics.vlt * 0.01) + " В";
-			QString message = QString("Успешно.<br>Ток насоса = ")
-					+ curr_str
-					+ "<br>Напряжение питания = "
-					+ vlt_str;
-			ShowInfo(message);
-
-			ui_process->vlt_label->setText(vlt_str);
-			ui_process->curr_label->setText(curr_str);
-		}
-		else if (event == DeviceDriver::EventCode::LaunchSingleCycleError)
-		{
-			current_state = State::Ready;
-			ShowInfo("Ошибка однократного запуска цикла :(");
-			emit Trace("EventCode::LaunchSingleCycleError\n");
-		}
-	}
-		break;
-	case State::Ready: break;
-	}
-}
-
-
 #include <chrono>
 
 void MainWindow::TerminalTrace(const QString & str)
@@ -511,6 +451,12 @@ void MainWindow::TerminalTrace(const QString & str)
 	static auto time_point = std::chrono::high_resolution_clock::now();
 	auto trace_time = std::chrono::high_resolution_clock::now();
 	auto delta = std::chrono::duration_cast<std::chrono::milliseconds>(trace_time - time_point).count();
-	ui_terminal->terminal->append(QString::number(delta) + "ms : " + str);
+	trace_model->Append(QString::number(delta) + "ms : " + str);
 	time_point = trace_time;
 }
+
+void MainWindow::TerminalFrame(Tracing::Direction direction, const QByteArray& frame)
+{
+	TerminalTrace((direction == Tracing::Direction::Out ? "out > " : "in   < ")
+				  + QString::fromLatin1(frame.trimmed()));
+}
@@ -2,10 +2,14 @@
 #define MAINWINDOW_H
 
 #include "device-driver.h"
+#include "connection-controller.h"
+#include "stats-panel.h"
+#include "trace-model.h"
 
 #include <QMainWindow>
 #include <QMouseEvent>
 #include <QThread>
+#include <QTimer>
 
 QT_BEGIN_NAMESPACE
 namespace Ui { class MainWindow; }
@@ -24,6 +28,9 @@ public:
 	MainWindow(QWidget *parent = nullptr);
 	~MainWindow();
 
+	// Запись обмена с устройством в двоичный файл
+	bool StartCapture(const QString& path);
+
 private:
 	Ui::MainWindow *ui;
 	Ui::LoadWidget *ui_loading;
@@ -39,6 +46,7 @@ private:
 	QWidget* terminal;
 
 	void mousePressEvent(QMouseEvent *event);
+	bool eventFilter(QObject *watched, QEvent *event) override;
 	void mouseMoveEvent(QMouseEvent *event);
 
 	void ShowInitial();
@@ -46,6 +54,7 @@ private:
 	void ShowLoading(const QString&);
 	void ShowAbout();
 	void ShowProcess();
+	void ShowCharacteristics();
 	void WriteValuesToWindow();
 	void ReadValuesFromControls();
 
@@ -66,42 +75,27 @@ public slots:
 	void WriteCountersButton();
 	void SwitchToAdminMode();
 	void ShowTerminal();
-	void Event(DeviceDriver::EventCode);
+	void ShowStats();
 	void TerminalTrace(const QString&);
-
-signals:
-	void ReadCounters();
-	void WriteCounters(const DeviceDriver::Counters);
-
-	void ReadParameters();
-	void WriteParameters(const DeviceDriver::Parameters);
-
-	void LaunchSingleCycle();
-	void FindDevice();
-	void Trace(const QString&);
+	void TerminalFrame(Tracing::Direction, const QByteArray&);
+	void SwitchPolling();
+	void ShowTelemetry();
 
 private:
-	enum class State {
-		Initial,
-		Connect,
-		Ready,
-		ReadCounters,
-		WriteCounters,
-		ReadParameters,
-		WriteParameters,
-		LaunchSingleCycle
-	};
-
-	State current_state;
+	CaptureWriter capture_writer; // объявлен раньше драйвера и переживает его
 	DeviceDriver device_driver;
 	QThread device_driver_thread;
+	ConnectionController controller;
 
 	DeviceDriver::Counters tmp_counters;
 	DeviceDriver::Parameters tmp_parameters;
 
-	DeviceDriver::Counters local_counters;
-	DeviceDriver::Parameters local_parameters;
-	DeviceDriver::MeasuredCharacteristics local_characteristics;
+	StatsPanel* stats_panel;
+	TraceModel* trace_model;
+	bool trace_follow; // прокручивать журнал к последней строке
+
+	QTimer* telemetry_timer;
+	QVector<DeviceDriver::TelemetrySample> telemetry_samples;
 
 	bool admin_mode;
 
@@ -0,0 +1,150 @@
+#include "port-cache.h"
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSettings>
+
+namespace {
+// С запасом на все порты группы DeviceFleet: иначе подключение группы
+// вытесняло бы собственные записи
+const int kMaxEntries = 128;
+const char* kArray = "devices";
+
+// Драйверы группы подключаются одновременно из своих потоков, а запись
+// массива - это чтение, удаление и запись заново
+QMutex g_mutex;
+
+bool SameUsbId(const PortCache::Entry& entry, const QSerialPortInfo& info)
+{
+	return entry.has_usb
+			&& info.hasVendorIdentifier()
+			&& info.hasProductIdentifier()
+			&& info.vendorIdentifier() == entry.vid
+			&& info.productIdentifier() == entry.pid;
+}
+
+void Save(const QList<PortCache::Entry>& entries)
+{
+	QSettings settings;
+	settings.remove(kArray);
+	settings.beginWriteArray(kArray, entries.size());
+	for (int i = 0; i < entries.size(); ++i) {
+		const auto& entry = entries.at(i);
+		settings.setArrayIndex(i);
+		settings.setValue("port", entry.port);
+		settings.setValue("usb", entry.has_usb);
+		settings.setValue("vid", entry.vid);
+		settings.setValue("pid", entry.pid);
+		settings.setValue("serial", entry.serial);
+		settings.setValue("baud_rate", entry.baud_rate);
+	}
+	settings.endArray();
+	settings.sync();
+}
+
+QList<PortCache::Entry> LoadEntries()
+{
+	QList<PortCache::Entry> result;
+	QSettings settings;
+	const int size = settings.beginReadArray(kArray);
+	for (int i = 0; i < size; ++i) {
+		settings.setArrayIndex(i);
+		result.append({settings.value("port").toString(),
+					   settings.value("usb").toBool(),
+					   static_cast<quint16>(settings.value("vid").toUInt()),
+					   static_cast<quint16>(settings.value("pid").toUInt()),
+					   settings.value("serial").toString(),
+					   settings.value("baud_rate").toInt()});
+	}
+	settings.endArray();
+	return result;
+}
+}
+
+QList<PortCache::Entry> PortCache::Load()
+{
+	QMutexLocker lock(&g_mutex);
+	return LoadEntries();
+}
+
+void PortCache::Remember(const QSerialPortInfo& info, qint32 baud_rate)
+{
+	// Пути вне списка Qt (псевдотерминалы) не запоминаются: у пустого
+	// QSerialPortInfo нет имени, и запись совпала бы с любым таким портом
+	if (info.isNull()) {
+		return;
+	}
+
+	const bool has_usb = info.hasVendorIdentifier() && info.hasProductIdentifier();
+	const Entry entry = {info.portName(),
+						 has_usb,
+						 has_usb ? info.vendorIdentifier() : quint16(0),
+						 has_usb ? info.productIdentifier() : quint16(0),
+						 info.serialNumber(),
+						 baud_rate};
+
+	QMutexLocker lock(&g_mutex);
+	auto entries = LoadEntries();
+	for (int i = entries.size() - 1; i >= 0; --i) {
+		if (Matches(entries.at(i), info)) {
+			entries.removeAt(i);
+		}
+	}
+	entries.prepend(entry);
+	while (entries.size() > kMaxEntries) {
+		entries.removeLast();
+	}
+	Save(entries);
+}
+
+qint32 PortCache::BaudRate(const QSerialPortInfo& info)
+{
+	const auto entries = Load();
+	for (const auto& entry : entries) {
+		if (Matches(entry, info)) {
+			return entry.baud_rate;
+		}
+	}
+	return 0;
+}
+
+bool PortCache::Matches(const Entry& entry, const QSerialPortInfo& info)
+{
+	if (info.isNull()) {
+		return false;
+	}
+	// Номер ttyUSB/COM меняется при переподключении, серийный номер - нет
+	if (!entry.serial.isEmpty() && info.serialNumber() == entry.serial) {
+		return !entry.has_usb || SameUsbId(entry, info);
+	}
+	return info.portName() == entry.port
+			&& (!entry.has_usb || SameUsbId(entry, info));
+}
+
+bool PortCache::IsKnownUsbId(const QSerialPortInfo& info)
+{
+	if (!info.hasVendorIdentifier() || !info.hasProductIdentifier()) {
+		return false;
+	}
+
+	const auto entries = Load();
+	for (const auto& entry : entries) {
+		if (SameUsbId(entry, info)) {
+			return true;
+		}
+	}
+
+	const auto ids = QSettings().value("serial/usb_ids").toStringList();
+	for (const auto& id : ids) {
+		const auto parts = id.split(':');
+		bool vid_ok = false;
+		bool pid_ok = false;
+		if (parts.size() == 2
+				&& parts.at(0).toUShort(&vid_ok, 16) == info.vendorIdentifier()
+				&& parts.at(1).toUShort(&pid_ok, 16) == info.productIdentifier()
+				&& vid_ok && pid_ok)
+		{
+			return true;
+		}
+	}
+	return false;
+}
@@ -0,0 +1,37 @@
+#ifndef PORTCACHE_H
+#define PORTCACHE_H
+
+#include <QList>
+#include <QSerialPortInfo>
+#include <QString>
+
+// Сохранённые в QSettings порты, на которых раньше находилось устройство:
+// имя, USB VID/PID/серийный номер и скорость. Позволяет при повторном
+// подключении начать с известного порта и не пинговать посторонние.
+class PortCache
+{
+public:
+	struct Entry {
+		QString port;
+		bool has_usb;
+		quint16 vid;
+		quint16 pid;
+		QString serial;
+		qint32 baud_rate;
+	};
+
+	// Самые свежие записи первыми; вызовы допустимы из любого потока
+	static QList<Entry> Load();
+	static void Remember(const QSerialPortInfo&, qint32 baud_rate);
+
+	// Скорость, на которой устройство отвечало на этом порту, 0 - неизвестна
+	static qint32 BaudRate(const QSerialPortInfo&);
+
+	// Тот же адаптер: по серийному номеру, если он есть, иначе по имени порта
+	static bool Matches(const Entry&, const QSerialPortInfo&);
+
+	// USB-идентификаторы из кэша и настройки serial/usb_ids ("0403:6001")
+	static bool IsKnownUsbId(const QSerialPortInfo&);
+};
+
+#endif // PORTCACHE_H
@@ -0,0 +1,141 @@
+#include "port-watcher.h"
+#include "device-discovery.h"
+
+#include <QFileInfo>
+#include <QSocketNotifier>
+#include <QTimer>
+
+#ifdef Q_OS_LINUX
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace {
+const int kSettleDelay = 50; // udev выставляет права на узел чуть позже его создания (мс)
+const int kPollInterval = 1000; // период опроса без inotify (мс)
+}
+
+PortWatcher::PortWatcher(QObject *parent)
+	: QObject(parent)
+	, _inotify(-1)
+	, _notifier(nullptr)
+	, _poll_timer(nullptr)
+{
+	const auto ports = DeviceDiscovery::AvailablePorts();
+	for (const auto& info : ports) {
+		_ports.insert(info.portName(), info);
+	}
+
+#ifdef Q_OS_LINUX
+	_inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (_inotify >= 0 && inotify_add_watch(_inotify, "/dev", IN_CREATE | IN_ATTRIB | IN_DELETE) >= 0) {
+		_notifier = new QSocketNotifier(_inotify, QSocketNotifier::Read, this);
+		connect(_notifier, &QSocketNotifier::activated, this, &PortWatcher::ReadEvents);
+		return;
+	}
+	if (_inotify >= 0) {
+		close(_inotify);
+		_inotify = -1;
+	}
+#endif
+
+	_poll_timer = new QTimer(this);
+	_poll_timer->setInterval(kPollInterval);
+	connect(_poll_timer, &QTimer::timeout, this, &PortWatcher::Rescan);
+	_poll_timer->start();
+}
+
+PortWatcher::~PortWatcher()
+{
+#ifdef Q_OS_LINUX
+	if (_inotify >= 0) {
+		delete _notifier;
+		close(_inotify);
+	}
+#endif
+}
+
+QList<QSerialPortInfo> PortWatcher::Ports() const
+{
+	return _ports.values();
+}
+
+void PortWatcher::ReadEvents()
+{
+#ifdef Q_OS_LINUX
+	alignas(inotify_event) char buffer[4096];
+	for (;;) {
+		const ssize_t size = read(_inotify, buffer, sizeof(buffer));
+		if (size <= 0) {
+			return;
+		}
+
+		for (ssize_t offset = 0; offset < size; ) {
+			const auto event = reinterpret_cast<const inotify_event*>(buffer + offset);
+			offset += sizeof(inotify_event) + event->len;
+
+			const QString name = event->len ? QString::fromLocal8Bit(event->name) : QString();
+			if (!IsSerialNode(name)) {
+				continue;
+			}
+
+			if (event->mask & IN_DELETE) {
+				Remove(name);
+			} else if (!_ports.contains(name)) {
+				QTimer::singleShot(kSettleDelay, this, [this, name]() { CheckAdded(name); });
+			}
+		}
+	}
+#endif
+}
+
+void PortWatcher::CheckAdded(const QString& port)
+{
+	if (_ports.contains(port) || !QFileInfo::exists("/dev/" + port)) {
+		return;
+	}
+
+	// Узел /dev ещё не значит последовательный порт: проверяем по списку Qt
+	const QSerialPortInfo info(port);
+	if (info.isNull()) {
+		return;
+	}
+	_ports.insert(port, info);
+	emit PortAdded(info);
+}
+
+void PortWatcher::Remove(const QString& port)
+{
+	if (_ports.remove(port)) {
+		emit PortRemoved(port);
+	}
+}
+
+void PortWatcher::Rescan()
+{
+	QMap<QString, QSerialPortInfo> current;
+	const auto ports = DeviceDiscovery::AvailablePorts();
+	for (const auto& info : ports) {
+		current.insert(info.portName(), info);
+	}
+
+	const auto known = _ports.keys();
+	for (const auto& port : known) {
+		if (!current.contains(port)) {
+			Remove(port);
+		}
+	}
+	for (auto it = current.cbegin(); it != current.cend(); ++it) {
+		if (!_ports.contains(it.key())) {
+			_ports.insert(it.key(), it.value());
+			emit PortAdded(it.value());
+		}
+	}
+}
+
+bool PortWatcher::IsSerialNode(const QString& name)
+{
+	// tty0..tty63 - виртуальные консоли, не порты
+	return (name.startsWith("tty") && name.length() > 3 && !name.at(3).isDigit())
+			|| name.startsWith("rfcomm");
+}
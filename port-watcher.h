@@ -0,0 +1,44 @@
+#ifndef PORTWATCHER_H
+#define PORTWATCHER_H
+
+#include <QMap>
+#include <QObject>
+#include <QSerialPortInfo>
+
+class QSocketNotifier;
+class QTimer;
+
+// Текущий список последовательных портов без повторного перебора.
+// В Linux узлы /dev отслеживаются через inotify, и подключение адаптера
+// видно через миллисекунды; на других системах список опрашивается
+// раз в секунду и сравнивается с прежним.
+class PortWatcher : public QObject
+{
+	Q_OBJECT
+
+public:
+	explicit PortWatcher(QObject *parent = nullptr);
+	~PortWatcher();
+
+	QList<QSerialPortInfo> Ports() const;
+
+signals:
+	void PortAdded(const QSerialPortInfo&);
+	void PortRemoved(const QString& port);
+
+private:
+	QMap<QString, QSerialPortInfo> _ports;
+	int _inotify;
+	QSocketNotifier* _notifier;
+	QTimer* _poll_timer;
+
+private:
+	void ReadEvents();
+	void CheckAdded(const QString& port);
+	void Remove(const QString& port);
+	void Rescan();
+
+	static bool IsSerialNode(const QString& name);
+};
+
+#endif // PORTWATCHER_H
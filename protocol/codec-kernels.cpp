@@ -0,0 +1,274 @@
+#include "codec-kernels.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define KERNELS_SSE2
+#include <emmintrin.h>
+#endif
+
+// AVX2 выбирается во время выполнения, сборка остаётся под базовый x86-64
+#if defined(KERNELS_SSE2) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define KERNELS_AVX2
+#include <immintrin.h>
+#endif
+
+namespace Kernels {
+
+namespace {
+
+const char kHexLower[] = "0123456789abcdef";
+const char kHexUpper[] = "0123456789ABCDEF";
+
+// Медленный путь: повторяет QByteArray::fromHex - не-hex символы
+// пропускаются, при нечётном числе цифр первая цифра образует отдельный байт
+uint8_t Crc8HexLenient(const char* hex, size_t size, uint8_t crc)
+{
+	size_t digits = 0;
+	for (size_t i = 0; i < size; ++i) {
+		if (HexValue(hex[i]) >= 0) {
+			++digits;
+		}
+	}
+
+	int high = (digits % 2) ? 0 : -1;
+	for (size_t i = 0; i < size; ++i) {
+		const int value = HexValue(hex[i]);
+		if (value < 0) {
+			continue;
+		}
+		if (high < 0) {
+			high = value;
+		} else {
+			crc = Crc8Step(crc, static_cast<uint8_t>((high << 4) | value));
+			high = -1;
+		}
+	}
+	return crc;
+}
+
+void HexEncodeScalar(const uint8_t* data, size_t size, char* out, bool upper)
+{
+	const char* digits = upper ? kHexUpper : kHexLower;
+	for (size_t i = 0; i < size; ++i) {
+		out[2 * i] = digits[data[i] >> 4];
+		out[2 * i + 1] = digits[data[i] & 0x0F];
+	}
+}
+
+bool HexDecodeScalar(const char* hex, size_t size, uint8_t* out)
+{
+	int invalid = 0;
+	for (size_t i = 0; i < size; ++i) {
+		const int high = HexValue(hex[2 * i]);
+		const int low = HexValue(hex[2 * i + 1]);
+		invalid |= high | low;
+		out[i] = static_cast<uint8_t>(((high & 0x0F) << 4) | (low & 0x0F));
+	}
+	return invalid >= 0;
+}
+
+#ifdef KERNELS_SSE2
+
+inline __m128i NibblesToAscii128(__m128i nibbles, __m128i alpha_offset)
+{
+	const __m128i is_alpha = _mm_cmpgt_epi8(nibbles, _mm_set1_epi8(9));
+	return _mm_add_epi8(_mm_add_epi8(nibbles, _mm_set1_epi8('0')),
+						_mm_and_si128(is_alpha, alpha_offset));
+}
+
+void HexEncodeSse2(const uint8_t* data, size_t size, char* out, bool upper)
+{
+	const __m128i mask = _mm_set1_epi8(0x0F);
+	const __m128i alpha_offset = _mm_set1_epi8(upper ? 'A' - '0' - 10 : 'a' - '0' - 10);
+
+	size_t i = 0;
+	for (; i + 16 <= size; i += 16) {
+		const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+		const __m128i high = NibblesToAscii128(_mm_and_si128(_mm_srli_epi16(bytes, 4), mask), alpha_offset);
+		const __m128i low = NibblesToAscii128(_mm_and_si128(bytes, mask), alpha_offset);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out + 2 * i), _mm_unpacklo_epi8(high, low));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out + 2 * i + 16), _mm_unpackhi_epi8(high, low));
+	}
+	HexEncodeScalar(data + i, size - i, out + 2 * i, upper);
+}
+
+// 16 символов -> 16 значений тетрад, invalid накапливает ошибочные позиции
+inline __m128i AsciiToNibbles128(__m128i chars, __m128i& invalid)
+{
+	const __m128i digit = _mm_sub_epi8(chars, _mm_set1_epi8('0'));
+	const __m128i is_digit = _mm_cmpeq_epi8(_mm_min_epu8(digit, _mm_set1_epi8(9)), digit);
+	const __m128i alpha = _mm_sub_epi8(_mm_or_si128(chars, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+	const __m128i is_alpha = _mm_cmpeq_epi8(_mm_min_epu8(alpha, _mm_set1_epi8(5)), alpha);
+
+	invalid = _mm_or_si128(invalid, _mm_andnot_si128(_mm_or_si128(is_digit, is_alpha), _mm_set1_epi8(-1)));
+	return _mm_or_si128(_mm_and_si128(is_digit, digit),
+						_mm_and_si128(is_alpha, _mm_add_epi8(alpha, _mm_set1_epi8(10))));
+}
+
+// Пары тетрад (старшая в чётном байте) -> байты в младших половинах 16-битных слов
+inline __m128i CombineNibbles128(__m128i nibbles)
+{
+	return _mm_or_si128(_mm_slli_epi16(_mm_and_si128(nibbles, _mm_set1_epi16(0x00FF)), 4),
+						_mm_srli_epi16(nibbles, 8));
+}
+
+bool HexDecodeSse2(const char* hex, size_t size, uint8_t* out)
+{
+	__m128i invalid = _mm_setzero_si128();
+
+	size_t i = 0;
+	for (; i + 16 <= size; i += 16) {
+		const __m128i first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(hex + 2 * i));
+		const __m128i second = _mm_loadu_si128(reinterpret_cast<const __m128i*>(hex + 2 * i + 16));
+		const __m128i bytes = _mm_packus_epi16(CombineNibbles128(AsciiToNibbles128(first, invalid)),
+											   CombineNibbles128(AsciiToNibbles128(second, invalid)));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), bytes);
+	}
+
+	const bool tail_ok = HexDecodeScalar(hex + 2 * i, size - i, out + i);
+	return tail_ok && _mm_movemask_epi8(invalid) == 0;
+}
+
+#endif // KERNELS_SSE2
+
+#ifdef KERNELS_AVX2
+
+__attribute__((target("avx2")))
+inline __m256i NibblesToAscii256(__m256i nibbles, __m256i alpha_offset)
+{
+	const __m256i is_alpha = _mm256_cmpgt_epi8(nibbles, _mm256_set1_epi8(9));
+	return _mm256_add_epi8(_mm256_add_epi8(nibbles, _mm256_set1_epi8('0')),
+						   _mm256_and_si256(is_alpha, alpha_offset));
+}
+
+__attribute__((target("avx2")))
+void HexEncodeAvx2(const uint8_t* data, size_t size, char* out, bool upper)
+{
+	const __m256i mask = _mm256_set1_epi8(0x0F);
+	const __m256i alpha_offset = _mm256_set1_epi8(upper ? 'A' - '0' - 10 : 'a' - '0' - 10);
+
+	size_t i = 0;
+	for (; i + 32 <= size; i += 32) {
+		const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+		const __m256i high = NibblesToAscii256(_mm256_and_si256(_mm256_srli_epi16(bytes, 4), mask), alpha_offset);
+		const __m256i low = NibblesToAscii256(_mm256_and_si256(bytes, mask), alpha_offset);
+		// unpack работает внутри 128-битных половин, порядок восстанавливается перестановкой
+		const __m256i first = _mm256_unpacklo_epi8(high, low);
+		const __m256i second = _mm256_unpackhi_epi8(high, low);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 2 * i),
+							_mm256_permute2x128_si256(first, second, 0x20));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 2 * i + 32),
+							_mm256_permute2x128_si256(first, second, 0x31));
+	}
+	HexEncodeSse2(data + i, size - i, out + 2 * i, upper);
+}
+
+__attribute__((target("avx2")))
+inline __m256i AsciiToNibbles256(__m256i chars, __m256i& invalid)
+{
+	const __m256i digit = _mm256_sub_epi8(chars, _mm256_set1_epi8('0'));
+	const __m256i is_digit = _mm256_cmpeq_epi8(_mm256_min_epu8(digit, _mm256_set1_epi8(9)), digit);
+	const __m256i alpha = _mm256_sub_epi8(_mm256_or_si256(chars, _mm256_set1_epi8(0x20)), _mm256_set1_epi8('a'));
+	const __m256i is_alpha = _mm256_cmpeq_epi8(_mm256_min_epu8(alpha, _mm256_set1_epi8(5)), alpha);
+
+	invalid = _mm256_or_si256(invalid, _mm256_andnot_si256(_mm256_or_si256(is_digit, is_alpha), _mm256_set1_epi8(-1)));
+	return _mm256_or_si256(_mm256_and_si256(is_digit, digit),
+						   _mm256_and_si256(is_alpha, _mm256_add_epi8(alpha, _mm256_set1_epi8(10))));
+}
+
+__attribute__((target("avx2")))
+inline __m256i CombineNibbles256(__m256i nibbles)
+{
+	return _mm256_or_si256(_mm256_slli_epi16(_mm256_and_si256(nibbles, _mm256_set1_epi16(0x00FF)), 4),
+						   _mm256_srli_epi16(nibbles, 8));
+}
+
+__attribute__((target("avx2")))
+bool HexDecodeAvx2(const char* hex, size_t size, uint8_t* out)
+{
+	__m256i invalid = _mm256_setzero_si256();
+
+	size_t i = 0;
+	for (; i + 32 <= size; i += 32) {
+		const __m256i first = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(hex + 2 * i));
+		const __m256i second = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(hex + 2 * i + 32));
+		const __m256i packed = _mm256_packus_epi16(CombineNibbles256(AsciiToNibbles256(first, invalid)),
+												   CombineNibbles256(AsciiToNibbles256(second, invalid)));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i),
+							_mm256_permute4x64_epi64(packed, 0xD8));
+	}
+
+	const bool tail_ok = HexDecodeSse2(hex + 2 * i, size - i, out + i);
+	return tail_ok && _mm256_movemask_epi8(invalid) == 0;
+}
+
+bool HasAvx2()
+{
+	static const bool kHasAvx2 = []() {
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2") != 0;
+	}();
+	return kHasAvx2;
+}
+
+#endif // KERNELS_AVX2
+
+}
+
+uint8_t Crc8(const uint8_t* data, size_t size, uint8_t crc)
+{
+	for (size_t i = 0; i < size; ++i) {
+		crc = Crc8Step(crc, data[i]);
+	}
+	return crc;
+}
+
+uint8_t Crc8Hex(const char* hex, size_t size, uint8_t crc)
+{
+	if (size % 2 == 0) {
+		uint8_t result = crc;
+		size_t i = 0;
+		for (; i < size; i += 2) {
+			const int high = HexValue(hex[i]);
+			const int low = HexValue(hex[i + 1]);
+			if ((high | low) < 0) {
+				break;
+			}
+			result = Crc8Step(result, static_cast<uint8_t>((high << 4) | low));
+		}
+		if (i == size) {
+			return result;
+		}
+	}
+	return Crc8HexLenient(hex, size, crc);
+}
+
+void HexEncode(const uint8_t* data, size_t size, char* out, bool upper)
+{
+#if defined(KERNELS_AVX2)
+	if (HasAvx2()) {
+		HexEncodeAvx2(data, size, out, upper);
+		return;
+	}
+#endif
+#if defined(KERNELS_SSE2)
+	HexEncodeSse2(data, size, out, upper);
+#else
+	HexEncodeScalar(data, size, out, upper);
+#endif
+}
+
+bool HexDecode(const char* hex, size_t size, uint8_t* out)
+{
+#if defined(KERNELS_AVX2)
+	if (HasAvx2()) {
+		return HexDecodeAvx2(hex, size, out);
+	}
+#endif
+#if defined(KERNELS_SSE2)
+	return HexDecodeSse2(hex, size, out);
+#else
+	return HexDecodeScalar(hex, size, out);
+#endif
+}
+
+}
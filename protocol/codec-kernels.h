@@ -0,0 +1,81 @@
+#ifndef CODECKERNELS_H
+#define CODECKERNELS_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Вычислительные ядра уровня кадров: CRC8 (полином 0x31, начальное 0xFF)
+// и hex-кодек. Не зависят от Qt, результат побайтно совпадает
+// с прежним расчётом через QByteArray::fromHex/toHex и побитовый CRC8.
+namespace Kernels {
+
+constexpr uint8_t kCrc8Polynomial = 0x31;
+constexpr uint8_t kCrc8Init = 0xFF;
+
+constexpr uint8_t Crc8Bitwise(uint8_t crc)
+{
+	for (int i = 0; i < 8; ++i) {
+		crc = (crc & 0x80)
+				? static_cast<uint8_t>((crc << 1) ^ kCrc8Polynomial)
+				: static_cast<uint8_t>(crc << 1);
+	}
+	return crc;
+}
+
+constexpr std::array<uint8_t, 256> MakeCrc8Table()
+{
+	std::array<uint8_t, 256> table = {};
+	for (int i = 0; i < 256; ++i) {
+		table[i] = Crc8Bitwise(static_cast<uint8_t>(i));
+	}
+	return table;
+}
+
+inline constexpr std::array<uint8_t, 256> kCrc8Table = MakeCrc8Table();
+
+constexpr uint8_t Crc8Step(uint8_t crc, uint8_t byte)
+{
+	return kCrc8Table[crc ^ byte];
+}
+
+constexpr std::array<int8_t, 256> MakeHexValueTable()
+{
+	std::array<int8_t, 256> table = {};
+	for (int i = 0; i < 256; ++i) {
+		table[i] = -1;
+	}
+	for (int i = 0; i < 10; ++i) {
+		table['0' + i] = static_cast<int8_t>(i);
+	}
+	for (int i = 0; i < 6; ++i) {
+		table['a' + i] = static_cast<int8_t>(10 + i);
+		table['A' + i] = static_cast<int8_t>(10 + i);
+	}
+	return table;
+}
+
+inline constexpr std::array<int8_t, 256> kHexValue = MakeHexValueTable();
+
+// Значение hex-цифры, -1 - не hex
+constexpr int HexValue(char c)
+{
+	return kHexValue[static_cast<uint8_t>(c)];
+}
+
+// CRC8 по двоичным данным
+uint8_t Crc8(const uint8_t* data, size_t size, uint8_t crc = kCrc8Init);
+
+// CRC8 по ASCII-hex без промежуточного декодирования.
+// Нечётная длина и не-hex символы обрабатываются как в QByteArray::fromHex
+uint8_t Crc8Hex(const char* hex, size_t size, uint8_t crc = kCrc8Init);
+
+// size байт -> 2*size символов
+void HexEncode(const uint8_t* data, size_t size, char* out, bool upper);
+
+// 2*size символов -> size байт; false при не-hex символе
+bool HexDecode(const char* hex, size_t size, uint8_t* out);
+
+}
+
+#endif // CODECKERNELS_H
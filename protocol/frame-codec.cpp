@@ -0,0 +1,165 @@
+#include "frame-codec.h"
+
+namespace Protocol {
+
+namespace {
+const char kCR = '\r';
+const char kLF = '\n';
+}
+
+void StartRequest(Opcode code, char* out)
+{
+	const uint8_t code_byte = static_cast<uint8_t>(code);
+	out[0] = kRequestStart;
+	Kernels::HexEncode(&code_byte, 1, out + 1, true);
+}
+
+size_t SealRequest(char* frame, size_t data_size)
+{
+	const uint8_t crc = Kernels::Crc8Hex(frame + 1, kCodeLength + data_size);
+	char* out = frame + kDataIndex + data_size;
+	Kernels::HexEncode(&crc, 1, out, true);
+	out[kCrcLength] = kCR;
+	out[kCrcLength + 1] = kLF;
+	return FrameSize(data_size);
+}
+
+size_t BuildRequest(Opcode code, const char* data, size_t size, char* out)
+{
+	StartRequest(code, out);
+	char* body = out + kDataIndex;
+	for (size_t i = 0; i < size; ++i) {
+		const char c = data[i];
+		body[i] = (c >= 'a' && c <= 'f') ? static_cast<char>(c - 'a' + 'A') : c;
+	}
+	return SealRequest(out, size);
+}
+
+bool FrameCode(const char* frame, size_t size, Opcode* code)
+{
+	uint8_t code_byte = 0;
+	if (size < kDataIndex || !Kernels::HexDecode(frame + 1, 1, &code_byte)) {
+		return false;
+	}
+	*code = static_cast<Opcode>(code_byte);
+	return true;
+}
+
+bool CheckCrc(const char* frame, size_t size)
+{
+	if (size <= 1 + kCrcLength + 2) {
+		return false;
+	}
+
+	const char* body = frame + 1;
+	const size_t body_size = size - 1 - kCrcLength - 2;
+	const uint8_t crc = Kernels::Crc8Hex(body, body_size);
+
+	char calc_crc[kCrcLength];
+	Kernels::HexEncode(&crc, 1, calc_crc, true);
+	return body[body_size] == calc_crc[0]
+			&& body[body_size + 1] == calc_crc[1];
+}
+
+Span ReplyData(const char* frame, size_t size)
+{
+	if (size <= kFrameOverhead) {
+		return {frame + (size < kDataIndex ? size : kDataIndex), 0};
+	}
+	return {frame + kDataIndex, size - kFrameOverhead};
+}
+
+FrameAssembler::FrameAssembler()
+{
+	Reset();
+}
+
+bool FrameAssembler::Push(char c)
+{
+	if (c == kReplyStart) {
+		// Начало нового кадра: недособранный предыдущий отбрасывается
+		Start();
+		return false;
+	}
+
+	if (_length == 0) {
+		return false;
+	}
+
+	if (_length >= kMaxFrameLength) {
+		_length = 0;
+		return false;
+	}
+
+	const bool after_cr = _frame[_length - 1] == kCR;
+	_frame[_length++] = c;
+
+	if (after_cr) {
+		if (c == kLF) {
+			Complete();
+			return true;
+		}
+		_valid = false;
+	} else if (c != kCR) {
+		PushDigit(c);
+	}
+	return false;
+}
+
+void FrameAssembler::Reset()
+{
+	_length = 0;
+	_completed = 0;
+	_crc_ok = false;
+	_crc = Kernels::kCrc8Init;
+	_nibble = -1;
+	_held = -1;
+	_decoded = 0;
+	_valid = true;
+}
+
+void FrameAssembler::Start()
+{
+	_frame[0] = kReplyStart;
+	_length = 1;
+	_crc = Kernels::kCrc8Init;
+	_nibble = -1;
+	_held = -1;
+	_decoded = 0;
+	_valid = true;
+}
+
+void FrameAssembler::PushDigit(char c)
+{
+	const int value = Kernels::HexValue(c);
+	if (value < 0) {
+		_valid = false;
+		return;
+	}
+
+	if (_nibble < 0) {
+		_nibble = value;
+		return;
+	}
+
+	const int byte = (_nibble << 4) | value;
+	_nibble = -1;
+	if (_held >= 0) {
+		_crc = Kernels::Crc8Step(_crc, static_cast<uint8_t>(_held));
+	}
+	_held = byte;
+	++_decoded;
+}
+
+void FrameAssembler::Complete()
+{
+	// Минимум один байт данных и байт CRC
+	_crc_ok = _valid
+			&& _nibble < 0
+			&& _decoded >= 2
+			&& _held == _crc;
+	_completed = _length;
+	_length = 0;
+}
+
+}
@@ -0,0 +1,143 @@
+#ifndef FRAMECODEC_H
+#define FRAMECODEC_H
+
+#include "codec-kernels.h"
+#include "protocol-structs.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Кадры протокола: запрос "@<код><данные><CRC>\r\n", ответ "$<код><данные><CRC>\r\n",
+// код, данные и CRC в hex. Сборка в буфер вызывающего, разбор прямо по
+// принятым байтам; не зависит от Qt и цикла событий.
+namespace Protocol {
+
+enum class Opcode : uint8_t {
+	Ping = 0x55,
+	ReadCounters = 0x20,
+	WriteCounters = 0x2F,
+	ReadParameters = 0x30,
+	WriteParameters = 0x3F,
+	SingleCycle = 0x40
+};
+
+constexpr char kRequestStart = '@';
+constexpr char kReplyStart = '$';
+constexpr size_t kCodeLength = 2;
+constexpr size_t kCrcLength = 2;
+constexpr size_t kDataIndex = 1 + kCodeLength; // данные после начала и кода
+constexpr size_t kFrameOverhead = kDataIndex + kCrcLength + 2; // всё, кроме данных
+constexpr size_t kMaxFrameLength = 256;
+
+constexpr char HexDigit(unsigned value)
+{
+	return "0123456789ABCDEF"[value & 0x0F];
+}
+
+// "@" код CRC "\r\n" и начало ответа "$" код
+template <Opcode Code>
+struct FixedFrame {
+	static constexpr uint8_t kCode = static_cast<uint8_t>(Code);
+	static constexpr uint8_t kCrc = Kernels::Crc8Step(Kernels::kCrc8Init, kCode);
+	static constexpr char kRequest[] = {
+		kRequestStart, HexDigit(kCode >> 4), HexDigit(kCode), HexDigit(kCrc >> 4), HexDigit(kCrc), '\r', '\n'
+	};
+	static constexpr char kReply[] = {kReplyStart, HexDigit(kCode >> 4), HexDigit(kCode)};
+};
+
+// Пинг - единственный запрос без CRC
+constexpr char kPingRequest[] = {kRequestStart, '5', '5', '\r', '\n'};
+
+// Длина кадра с data_size символами hex-данных
+constexpr size_t FrameSize(size_t data_size)
+{
+	return kFrameOverhead + data_size;
+}
+
+// "@<код>" в начало out; данные пишутся следом, с out + kDataIndex
+void StartRequest(Opcode code, char* out);
+
+// CRC и "\r\n" после data_size символов данных; возвращает длину кадра
+size_t SealRequest(char* frame, size_t data_size);
+
+// Запрос с готовыми hex-данными: FrameSize(size) символов в out,
+// hex в верхнем регистре
+size_t BuildRequest(Opcode code, const char* data, size_t size, char* out);
+
+// Запрос с данными структуры: FrameSize(HexSize<Struct>()) символов в out
+template <class Struct>
+size_t BuildRequest(Opcode code, const Struct& value, char* out)
+{
+	StartRequest(code, out);
+	Encode(value, out + kDataIndex, true);
+	return SealRequest(out, HexSize<Struct>());
+}
+
+// Код команды из кадра запроса или ответа; false - кадр короче кода
+// или код не hex
+bool FrameCode(const char* frame, size_t size, Opcode* code);
+
+// CRC кадра ответа по hex внутри него, без копий
+bool CheckCrc(const char* frame, size_t size);
+
+// Данные ответа между кодом команды и CRC, указывают внутрь кадра
+struct Span {
+	const char* data;
+	size_t size;
+};
+
+Span ReplyData(const char* frame, size_t size);
+
+// Потоковая сборка кадров ответа из произвольных кусков, приходящих из
+// порта. Кадр может прийти частями, несколько кадров - одним куском.
+// CRC считается по мере поступления байт.
+class FrameAssembler
+{
+public:
+	FrameAssembler();
+
+	// Очередной байт потока; true - собран кадр, Frame() и Size() верны
+	// до следующего вызова
+	bool Push(char);
+
+	// handler(const char* frame, size_t size, bool crc_ok) на каждый кадр
+	template <class Handler>
+	void Append(const char* data, size_t size, Handler&& handler)
+	{
+		for (size_t i = 0; i < size; ++i) {
+			if (Push(data[i])) {
+				handler(Frame(), Size(), CrcOk());
+			}
+		}
+	}
+
+	const char* Frame() const { return _frame.data(); }
+	size_t Size() const { return _completed; }
+	bool CrcOk() const { return _crc_ok; }
+
+	void Reset();
+
+private:
+	std::array<char, kMaxFrameLength> _frame;
+	size_t _length; // текущий недособранный кадр, 0 - ждём '$'
+	size_t _completed; // длина последнего собранного кадра
+	bool _crc_ok;
+
+	// Состояние CRC: последний декодированный байт придерживается,
+	// т.к. до "\r\n" неизвестно, данные это или CRC
+	uint8_t _crc;
+	int _nibble; // старшая тетрада текущего байта, -1 если нет
+	int _held; // придержанный байт, -1 если нет
+	int _decoded; // количество декодированных байт
+	bool _valid;
+
+private:
+	void Start();
+	void PushDigit(char);
+	void Complete();
+};
+
+}
+
+#endif // FRAMECODEC_H
@@ -0,0 +1,116 @@
+#ifndef PROTOCOLSTRUCTS_H
+#define PROTOCOLSTRUCTS_H
+
+#include "struct-codec.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Данные команд протокола и их раскладка на линии. Кодирование и разбор
+// hex-данных кадра - через Layout<Struct>, без Qt и выделения памяти.
+namespace Protocol {
+
+// Счетчики
+struct Counters {
+	uint32_t time; // общее время работы (с)
+	uint32_t cycles; // общее количество циклов
+};
+
+// Параметры
+struct Parameters {
+	uint16_t cpm; // граница тока мотора (мА)
+	uint16_t tp; // время теста насоса [0 .. 10 000](мс)
+	uint16_t tbc; // время паузы между циклами [0 .. 60 000](мс)
+	uint16_t tbtp; // время между тестами насоса [0 .. 28 800](c)
+	uint8_t ct; // время цикла установлена [программно (0xFF) / от внутреннего резистора (0x00)]
+	uint16_t tw; // время цикла, если программно [40 .. 600](мс)
+};
+
+// Измеренные характеристики
+struct MeasuredCharacteristics {
+	uint16_t vlt; // напряжение питания платы, цмр kVoltageScale (В)
+	uint16_t curr; // ток насоса во время цикла, цмр kCurrentScale (А)
+};
+
+// Цена младшего разряда MeasuredCharacteristics, общая для всех интерфейсов
+constexpr double kVoltageScale = 0.01;
+constexpr double kCurrentScale = 0.001;
+
+// Запрос или ответ без данных
+struct NoPayload {
+};
+
+// Порядок и пределы полей на линии
+template <class Struct>
+struct Layout;
+
+template <>
+struct Layout<Counters> {
+	static constexpr std::array<StructCodec::Field<Counters>, 2> kFields = {{
+		StructCodec::MakeField<&Counters::cycles>("cycles"),
+		StructCodec::MakeField<&Counters::time>("time")
+	}};
+};
+
+template <>
+struct Layout<Parameters> {
+	static constexpr std::array<StructCodec::Field<Parameters>, 6> kFields = {{
+		StructCodec::MakeField<&Parameters::cpm>("cpm"),
+		StructCodec::MakeField<&Parameters::tp>("tp", 0, 10000),
+		StructCodec::MakeField<&Parameters::tbc>("tbc", 0, 60000),
+		StructCodec::MakeField<&Parameters::tbtp>("tbtp", 0, 28800),
+		StructCodec::MakeField<&Parameters::ct>("ct", 0x00, 0xFF, StructCodec::Check::Either),
+		StructCodec::MakeField<&Parameters::tw>("tw", 40, 600)
+	}};
+};
+
+template <>
+struct Layout<MeasuredCharacteristics> {
+	static constexpr std::array<StructCodec::Field<MeasuredCharacteristics>, 2> kFields = {{
+		StructCodec::MakeField<&MeasuredCharacteristics::vlt>("vlt"),
+		StructCodec::MakeField<&MeasuredCharacteristics::curr>("curr")
+	}};
+};
+
+template <>
+struct Layout<NoPayload> {
+	static constexpr std::array<StructCodec::Field<NoPayload>, 0> kFields = {};
+};
+
+static_assert(StructCodec::WireSize(Layout<Counters>::kFields) == 8, "counters are 8 bytes");
+static_assert(StructCodec::WireSize(Layout<Parameters>::kFields) == 11, "parameters are 11 bytes");
+static_assert(StructCodec::WireSize(Layout<MeasuredCharacteristics>::kFields) == 4, "characteristics are 4 bytes");
+
+// Длина hex-данных структуры в кадре
+template <class Struct>
+constexpr size_t HexSize()
+{
+	return 2 * StructCodec::WireSize(Layout<Struct>::kFields);
+}
+
+// Структура -> HexSize<Struct>() символов в out
+template <class Struct>
+void Encode(const Struct& value, char* out, bool upper = false)
+{
+	StructCodec::EncodeHex(value, Layout<Struct>::kFields, out, upper);
+}
+
+// Hex-данные кадра -> структура; false при другой длине или не-hex символе,
+// out тогда не меняется
+template <class Struct>
+bool Decode(const char* hex, size_t size, Struct* out)
+{
+	return StructCodec::DecodeHex(hex, size, Layout<Struct>::kFields, out);
+}
+
+// nullptr - все поля в допустимых пределах, иначе первое неверное
+template <class Struct>
+const StructCodec::Field<Struct>* Validate(const Struct& value)
+{
+	return StructCodec::Validate(value, Layout<Struct>::kFields);
+}
+
+}
+
+#endif // PROTOCOLSTRUCTS_H
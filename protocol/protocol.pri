@@ -0,0 +1,15 @@
+# Qt-free protocol core: framing, CRC8 and struct codecs.
+# Apps and tools pull the sources in with include(<path>/protocol/protocol.pri).
+
+INCLUDEPATH += $$PWD
+DEPENDPATH += $$PWD
+
+SOURCES += \
+    $$PWD/codec-kernels.cpp \
+    $$PWD/frame-codec.cpp
+
+HEADERS += \
+    $$PWD/codec-kernels.h \
+    $$PWD/frame-codec.h \
+    $$PWD/protocol-structs.h \
+    $$PWD/struct-codec.h
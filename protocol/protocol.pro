@@ -0,0 +1,10 @@
+# Static library for services that run without Qt or an event loop;
+# depends on the C++17 standard library only.
+TEMPLATE = lib
+
+CONFIG += c++17 staticlib
+CONFIG -= qt
+
+TARGET = archipelago-protocol
+
+include(protocol.pri)
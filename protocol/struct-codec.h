@@ -0,0 +1,156 @@
+#ifndef STRUCTCODEC_H
+#define STRUCTCODEC_H
+
+#include "codec-kernels.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+// Кодек структур протокола по таблице полей: порядок, размер на линии
+// (little-endian) и допустимые значения. Разбор идёт прямо по hex-данным
+// кадра или по байтам без копий и выделения памяти. Не зависит от Qt.
+namespace StructCodec {
+
+enum class Check {
+	Range, // min <= значение <= max
+	Either // только min или max (переключатель)
+};
+
+template <class Struct>
+struct Field {
+	const char* name;
+	uint8_t size; // байт на линии
+	uint32_t (*get)(const Struct&);
+	void (*set)(Struct&, uint32_t);
+	uint32_t min;
+	uint32_t max;
+	Check check;
+};
+
+template <class Member>
+struct MemberOf;
+
+template <class S, class T>
+struct MemberOf<T S::*> {
+	typedef S Struct;
+	typedef T Type;
+};
+
+template <auto Member>
+uint32_t GetMember(const typename MemberOf<decltype(Member)>::Struct& value)
+{
+	return value.*Member;
+}
+
+template <auto Member>
+void SetMember(typename MemberOf<decltype(Member)>::Struct& value, uint32_t field)
+{
+	value.*Member = static_cast<typename MemberOf<decltype(Member)>::Type>(field);
+}
+
+// Поле из указателя на член: размер на линии равен размеру члена
+template <auto Member>
+constexpr Field<typename MemberOf<decltype(Member)>::Struct> MakeField(
+		const char* name,
+		uint32_t min = 0,
+		uint32_t max = std::numeric_limits<typename MemberOf<decltype(Member)>::Type>::max(),
+		Check check = Check::Range)
+{
+	typedef typename MemberOf<decltype(Member)>::Type Type;
+	static_assert(sizeof(Type) <= sizeof(uint32_t), "field does not fit 32 bits");
+	return {name, sizeof(Type), &GetMember<Member>, &SetMember<Member>, min, max, check};
+}
+
+template <class Struct, size_t N>
+constexpr size_t WireSize(const std::array<Field<Struct>, N>& fields)
+{
+	size_t result = 0;
+	for (const auto& field : fields) {
+		result += field.size;
+	}
+	return result;
+}
+
+// size байт -> структура; false при несовпадении длины, out не меняется
+template <class Struct, size_t N>
+bool DecodeBytes(const uint8_t* data, size_t size, const std::array<Field<Struct>, N>& fields, Struct* out)
+{
+	if (size != WireSize(fields)) {
+		return false;
+	}
+
+	Struct result = *out;
+	for (const auto& field : fields) {
+		uint32_t value = 0;
+		for (int i = 0; i < field.size; ++i) {
+			value |= static_cast<uint32_t>(data[i]) << (8 * i);
+		}
+		field.set(result, value);
+		data += field.size;
+	}
+	*out = result;
+	return true;
+}
+
+// 2 * WireSize hex-символов -> структура; false при другой длине или не-hex символе
+template <class Struct, size_t N>
+bool DecodeHex(const char* hex, size_t size, const std::array<Field<Struct>, N>& fields, Struct* out)
+{
+	if (size != 2 * WireSize(fields)) {
+		return false;
+	}
+
+	Struct result = *out;
+	for (const auto& field : fields) {
+		uint32_t value = 0;
+		for (int i = 0; i < field.size; ++i) {
+			const int high = Kernels::HexValue(hex[2 * i]);
+			const int low = Kernels::HexValue(hex[2 * i + 1]);
+			if (high < 0 || low < 0) {
+				return false;
+			}
+			value |= static_cast<uint32_t>((high << 4) | low) << (8 * i);
+		}
+		field.set(result, value);
+		hex += 2 * field.size;
+	}
+	*out = result;
+	return true;
+}
+
+// Структура -> 2 * WireSize hex-символов в out
+template <class Struct, size_t N>
+void EncodeHex(const Struct& value, const std::array<Field<Struct>, N>& fields, char* out, bool upper = false)
+{
+	const char* digits = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+	for (const auto& field : fields) {
+		uint32_t raw = field.get(value);
+		for (int i = 0; i < field.size; ++i) {
+			*out++ = digits[(raw >> 4) & 0x0F];
+			*out++ = digits[raw & 0x0F];
+			raw >>= 8;
+		}
+	}
+}
+
+// nullptr - все поля в допустимых пределах, иначе первое неверное
+template <class Struct, size_t N>
+const Field<Struct>* Validate(const Struct& value, const std::array<Field<Struct>, N>& fields)
+{
+	for (const auto& field : fields) {
+		const uint32_t raw = field.get(value);
+		const bool valid = field.check == Check::Either
+				? (raw == field.min || raw == field.max)
+				: (raw >= field.min && raw <= field.max);
+		if (!valid) {
+			return &field;
+		}
+	}
+	return nullptr;
+}
+
+}
+
+#endif // STRUCTCODEC_H
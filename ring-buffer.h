@@ -0,0 +1,108 @@
+#ifndef RINGBUFFER_H
+#define RINGBUFFER_H
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// Кольцевой буфер фиксированной ёмкости без блокировок для одного
+// производителя и одного потребителя. Производитель никогда не ждёт:
+// при переполнении новый элемент отбрасывается и учитывается в Dropped().
+template <class T>
+class SpscRingBuffer
+{
+public:
+	explicit SpscRingBuffer(size_t capacity)
+		: _mask(RoundUpToPowerOfTwo(capacity) - 1)
+		, _items(_mask + 1)
+		, _head(0)
+		, _tail(0)
+		, _dropped(0)
+	{
+	}
+
+	SpscRingBuffer(const SpscRingBuffer&) = delete;
+	SpscRingBuffer& operator=(const SpscRingBuffer&) = delete;
+
+	size_t Capacity() const
+	{
+		return _mask + 1;
+	}
+
+	// Только поток-производитель
+	bool Push(const T& item)
+	{
+		const size_t head = _head.load(std::memory_order_relaxed);
+		if (head - _tail.load(std::memory_order_acquire) > _mask) {
+			_dropped.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+
+		_items[head & _mask] = item;
+		_head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Только поток-потребитель
+	bool Pop(T& item)
+	{
+		const size_t tail = _tail.load(std::memory_order_relaxed);
+		if (tail == _head.load(std::memory_order_acquire)) {
+			return false;
+		}
+
+		item = _items[tail & _mask];
+		_tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Только поток-потребитель: забирает до max элементов в конец out
+	template <class Container>
+	size_t Drain(Container& out, size_t max = static_cast<size_t>(-1))
+	{
+		const size_t tail = _tail.load(std::memory_order_relaxed);
+		const size_t head = _head.load(std::memory_order_acquire);
+
+		size_t count = head - tail;
+		if (count > max) {
+			count = max;
+		}
+		for (size_t i = 0; i < count; ++i) {
+			out.push_back(_items[(tail + i) & _mask]);
+		}
+
+		_tail.store(tail + count, std::memory_order_release);
+		return count;
+	}
+
+	size_t Size() const
+	{
+		return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire);
+	}
+
+	size_t Dropped() const
+	{
+		return _dropped.load(std::memory_order_relaxed);
+	}
+
+private:
+	static size_t RoundUpToPowerOfTwo(size_t value)
+	{
+		size_t result = 1;
+		while (result < value) {
+			result <<= 1;
+		}
+		return result;
+	}
+
+	// Индексы на разных строках кэша, чтобы потоки не мешали друг другу
+	static constexpr size_t kCacheLine = 64;
+
+	const size_t _mask;
+	std::vector<T> _items;
+	alignas(kCacheLine) std::atomic<size_t> _head;
+	alignas(kCacheLine) std::atomic<size_t> _tail;
+	alignas(kCacheLine) std::atomic<size_t> _dropped;
+};
+
+#endif // RINGBUFFER_H
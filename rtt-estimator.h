@@ -0,0 +1,66 @@
+#ifndef RTTESTIMATOR_H
+#define RTTESTIMATOR_H
+
+#include <algorithm>
+#include <cmath>
+
+// Таймаут ответа по сглаженному времени обмена и его разбросу
+// (Jacobson/Karels, как RTO в TCP): srtt + 4 * rttvar в пределах
+// [floor, ceiling]. До первого замера действует initial. Нижняя граница
+// покрывает задержку USB-переходников (таймер задержки 16 мс в обе стороны)
+// и обработку в устройстве: таймаут закрывает порт и запускает поиск заново.
+class RttEstimator
+{
+public:
+	RttEstimator(double floor_ms = 100, double ceiling_ms = 2000, double initial_ms = 500)
+		: _floor(floor_ms)
+		, _ceiling(ceiling_ms)
+		, _initial(initial_ms)
+	{
+		Reset();
+	}
+
+	void Reset()
+	{
+		_srtt = 0;
+		_rttvar = 0;
+		_samples = 0;
+		_timeout = _initial;
+	}
+
+	void Sample(double rtt_ms)
+	{
+		rtt_ms = std::max(0.0, rtt_ms);
+		if (!_samples) {
+			_srtt = rtt_ms;
+			_rttvar = rtt_ms / 2;
+		} else {
+			_rttvar = 0.75 * _rttvar + 0.25 * std::fabs(_srtt - rtt_ms);
+			_srtt = 0.875 * _srtt + 0.125 * rtt_ms;
+		}
+		++_samples;
+		_timeout = std::min(_ceiling, std::max(_floor, _srtt + 4 * _rttvar));
+	}
+
+	// После таймаута следующий ждёт вдвое дольше, пока не придёт ответ
+	void Backoff()
+	{
+		_timeout = std::min(_ceiling, _timeout * 2);
+	}
+
+	int Timeout() const { return static_cast<int>(std::ceil(_timeout)); }
+	double SmoothedRtt() const { return _srtt; }
+	double Variance() const { return _rttvar; }
+	int Samples() const { return _samples; }
+
+private:
+	double _floor;
+	double _ceiling;
+	double _initial;
+	double _srtt;
+	double _rttvar;
+	double _timeout;
+	int _samples;
+};
+
+#endif // RTTESTIMATOR_H
@@ -0,0 +1,77 @@
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// Публикация значения одним писателем для любого числа читателей без
+// блокировок. Читатель повторяет чтение, если попал на запись. Значение
+// хранится атомарными словами, поэтому гонок данных нет.
+template <class T>
+class SeqLock
+{
+	static_assert(std::is_trivially_copyable<T>::value, "SeqLock requires a trivially copyable type");
+
+public:
+	SeqLock()
+		: _sequence(0)
+	{
+		for (auto& word : _words) {
+			word.store(0, std::memory_order_relaxed);
+		}
+	}
+
+	SeqLock(const SeqLock&) = delete;
+	SeqLock& operator=(const SeqLock&) = delete;
+
+	// Только поток-писатель
+	void Store(const T& value)
+	{
+		uint64_t words[kWords] = {};
+		std::memcpy(words, &value, sizeof(T));
+
+		const uint64_t sequence = _sequence.load(std::memory_order_relaxed);
+		_sequence.store(sequence + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+
+		for (size_t i = 0; i < kWords; ++i) {
+			_words[i].store(words[i], std::memory_order_relaxed);
+		}
+
+		_sequence.store(sequence + 2, std::memory_order_release);
+	}
+
+	// Любой поток. generation - номер публикации, начиная с 0
+	T Load(uint64_t* generation = nullptr) const
+	{
+		uint64_t words[kWords];
+		uint64_t before = 0;
+		uint64_t after = 0;
+
+		do {
+			before = _sequence.load(std::memory_order_acquire);
+			for (size_t i = 0; i < kWords; ++i) {
+				words[i] = _words[i].load(std::memory_order_relaxed);
+			}
+			std::atomic_thread_fence(std::memory_order_acquire);
+			after = _sequence.load(std::memory_order_relaxed);
+		} while (before != after || (before & 1));
+
+		T value;
+		std::memcpy(&value, words, sizeof(T));
+		if (generation) {
+			*generation = before / 2;
+		}
+		return value;
+	}
+
+private:
+	static constexpr size_t kWords = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+	std::atomic<uint64_t> _sequence; // нечётное - идёт запись
+	std::atomic<uint64_t> _words[kWords];
+};
+
+#endif // SEQLOCK_H
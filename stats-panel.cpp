@@ -0,0 +1,107 @@
+#include "stats-panel.h"
+
+#include <QHeaderView>
+#include <QPushButton>
+#include <QTableWidget>
+#include <QTimer>
+#include <QVBoxLayout>
+
+namespace {
+const int kRefreshInterval = 1000; // мс
+
+QString FormatMs(uint64_t us)
+{
+	return QString::number(us / 1000.0, 'f', 2);
+}
+}
+
+StatsPanel::StatsPanel(Source source, std::function<void()> reset, QWidget *parent)
+	: QWidget(parent)
+	, _source(source)
+	, _reset(reset)
+	, _table(new QTableWidget(this))
+	, _refresh_timer(new QTimer(this))
+{
+	setWindowTitle("Statistics");
+	resize(900, 300);
+
+	QStringList headers = {"port", "command", "disconnects"};
+	for (int i = 0; i < DeviceStats::OutcomeCount; ++i) {
+		headers.append(DeviceStats::OutcomeName(static_cast<DeviceStats::Outcome>(i)));
+	}
+	for (int i = 0; i < DeviceStats::StageCount; ++i) {
+		const QString stage = DeviceStats::StageName(static_cast<DeviceStats::Stage>(i));
+		headers.append({stage + " p50", stage + " p99", stage + " max"});
+	}
+
+	_table->setColumnCount(headers.size());
+	_table->setHorizontalHeaderLabels(headers);
+	_table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+	_table->verticalHeader()->hide();
+	_table->horizontalHeader()->setSectionResizeMode(QHeaderView::ResizeToContents);
+
+	auto reset_button = new QPushButton("Reset", this);
+	connect(reset_button, &QPushButton::clicked, this, [this]() {
+		if (_reset) {
+			_reset();
+		}
+		Refresh();
+	});
+
+	auto layout = new QVBoxLayout(this);
+	layout->setContentsMargins(0, 0, 0, 0);
+	layout->addWidget(_table);
+	layout->addWidget(reset_button);
+
+	_refresh_timer->setInterval(kRefreshInterval);
+	connect(_refresh_timer, &QTimer::timeout, this, &StatsPanel::Refresh);
+}
+
+void StatsPanel::Refresh()
+{
+	const auto report = _source ? _source() : DeviceStats::Report();
+
+	int rows = 0;
+	for (const auto& port : report) {
+		rows += port.commands.size();
+	}
+	_table->setRowCount(rows);
+
+	int row = 0;
+	for (auto port = report.cbegin(); port != report.cend(); ++port) {
+		for (auto command = port->commands.cbegin(); command != port->commands.cend(); ++command) {
+			QStringList cells = {port.key(), command.key(), QString::number(port->disconnects)};
+			for (auto count : command->outcomes) {
+				cells.append(QString::number(count));
+			}
+			for (const auto& stage : command->stages) {
+				cells.append({FormatMs(stage.Percentile(50)),
+							  FormatMs(stage.Percentile(99)),
+							  FormatMs(stage.Max())});
+			}
+
+			for (int column = 0; column < cells.size(); ++column) {
+				auto item = _table->item(row, column);
+				if (!item) {
+					item = new QTableWidgetItem;
+					_table->setItem(row, column, item);
+				}
+				item->setText(cells.at(column));
+			}
+			++row;
+		}
+	}
+}
+
+void StatsPanel::showEvent(QShowEvent* event)
+{
+	Refresh();
+	_refresh_timer->start();
+	QWidget::showEvent(event);
+}
+
+void StatsPanel::hideEvent(QHideEvent* event)
+{
+	_refresh_timer->stop();
+	QWidget::hideEvent(event);
+}
@@ -0,0 +1,37 @@
+#ifndef STATSPANEL_H
+#define STATSPANEL_H
+
+#include "device-stats.h"
+
+#include <QWidget>
+#include <functional>
+
+class QTableWidget;
+class QTimer;
+
+// Окно статистики обмена: по строке на порт и команду, задержки этапов
+// p50/p99/max в мс и счётчики исходов. Обновляется, пока окно открыто.
+class StatsPanel : public QWidget
+{
+	Q_OBJECT
+
+public:
+	typedef std::function<DeviceStats::Report()> Source;
+
+	explicit StatsPanel(Source source, std::function<void()> reset, QWidget *parent = nullptr);
+
+public slots:
+	void Refresh();
+
+protected:
+	void showEvent(QShowEvent*) override;
+	void hideEvent(QHideEvent*) override;
+
+private:
+	Source _source;
+	std::function<void()> _reset;
+	QTableWidget* _table;
+	QTimer* _refresh_timer;
+};
+
+#endif // STATSPANEL_H
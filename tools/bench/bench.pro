@@ -0,0 +1,37 @@
+QT -= gui
+QT += core serialport
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TARGET = archipelago-bench
+
+INCLUDEPATH += ../..
+
+include(../../protocol/protocol.pri)
+
+SOURCES += \
+    ../../capture-file.cpp \
+    ../../device-discovery.cpp \
+    ../../device-driver.cpp \
+    ../../device-stats.cpp \
+    ../../frame-parser.cpp \
+    ../../port-cache.cpp \
+    ../../port-watcher.cpp \
+    main.cpp
+
+HEADERS += \
+    ../../capture-file.h \
+    ../../device-commands.h \
+    ../../device-discovery.h \
+    ../../device-driver.h \
+    ../../device-stats.h \
+    ../../field-cache.h \
+    ../../frame-parser.h \
+    ../../latency-histogram.h \
+    ../../port-cache.h \
+    ../../port-watcher.h \
+    ../../ring-buffer.h \
+    ../../rtt-estimator.h \
+    ../../seqlock.h \
+    ../../tracing.h
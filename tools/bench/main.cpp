@@ -0,0 +1,337 @@
+// Микробенчмарки кодека протокола DeviceDriver: время на операцию,
+// выделения памяти на операцию и пропускная способность.
+// --json выдаёт результаты для сравнения между сборками.
+
+#include "device-driver.h"
+#include "frame-codec.h"
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTextStream>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+// Подсчёт выделений. QByteArray выделяет память через malloc, поэтому
+// на glibc перехватывается malloc, иначе - только operator new
+namespace {
+std::atomic<quint64> g_allocations(0);
+}
+
+#if defined(__GLIBC__)
+extern "C" {
+void* __libc_malloc(size_t);
+void* __libc_calloc(size_t, size_t);
+void* __libc_realloc(void*, size_t);
+void __libc_free(void*);
+
+void* malloc(size_t size)
+{
+	g_allocations.fetch_add(1, std::memory_order_relaxed);
+	return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size)
+{
+	g_allocations.fetch_add(1, std::memory_order_relaxed);
+	return __libc_calloc(count, size);
+}
+
+void* realloc(void* pointer, size_t size)
+{
+	g_allocations.fetch_add(1, std::memory_order_relaxed);
+	return __libc_realloc(pointer, size);
+}
+
+void free(void* pointer)
+{
+	__libc_free(pointer);
+}
+}
+#else
+void* operator new(size_t size)
+{
+	g_allocations.fetch_add(1, std::memory_order_relaxed);
+	if (void* pointer = std::malloc(size ? size : 1)) {
+		return pointer;
+	}
+	throw std::bad_alloc();
+}
+
+void operator delete(void* pointer) noexcept
+{
+	std::free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept
+{
+	std::free(pointer);
+}
+#endif
+
+namespace {
+
+const int kRepetitions = 5;
+
+struct Result {
+	QString name;
+	quint64 iterations;
+	double ns_per_op;
+	double allocations_per_op;
+	double bytes_per_second;
+};
+
+// Не даёт компилятору выбросить вычисление результата
+template <class T>
+inline void Keep(const T& value)
+{
+#if defined(__GNUC__)
+	asm volatile("" : : "g"(&value) : "memory");
+#else
+	static volatile const void* sink;
+	sink = &value;
+#endif
+}
+
+class Bench
+{
+public:
+	Bench(qint64 min_time_ns, const QString& filter)
+		: _min_time_ns(min_time_ns)
+		, _filter(filter)
+	{
+	}
+
+	// bytes - объём данных, обрабатываемых за одну операцию
+	template <class F>
+	void Run(const QString& name, qint64 bytes, F&& body)
+	{
+		if (!_filter.isEmpty() && !name.contains(_filter)) {
+			return;
+		}
+
+		// Подбор числа итераций, чтобы замер шёл не меньше _min_time_ns
+		quint64 iterations = 1;
+		for (;;) {
+			const qint64 elapsed = Measure(iterations, body, nullptr);
+			if (elapsed >= _min_time_ns || iterations >= (quint64(1) << 32)) {
+				break;
+			}
+			const double scale = elapsed > 0 ? 1.4 * _min_time_ns / elapsed : 10.0;
+			iterations = static_cast<quint64>(iterations * qBound(2.0, scale, 10.0));
+		}
+
+		// Медиана по нескольким повторам
+		std::vector<qint64> times;
+		quint64 allocations = 0;
+		for (int i = 0; i < kRepetitions; ++i) {
+			times.push_back(Measure(iterations, body, &allocations));
+		}
+		std::nth_element(times.begin(), times.begin() + kRepetitions / 2, times.end());
+		const double ns_per_op = static_cast<double>(times[kRepetitions / 2]) / iterations;
+
+		_results.push_back({name,
+							iterations,
+							ns_per_op,
+							static_cast<double>(allocations) / (iterations * kRepetitions),
+							ns_per_op > 0 ? bytes * 1e9 / ns_per_op : 0.0});
+	}
+
+	const std::vector<Result>& Results() const
+	{
+		return _results;
+	}
+
+private:
+	qint64 _min_time_ns;
+	QString _filter;
+	std::vector<Result> _results;
+
+private:
+	template <class F>
+	qint64 Measure(quint64 iterations, F& body, quint64* allocations)
+	{
+		const quint64 allocations_before = g_allocations.load(std::memory_order_relaxed);
+		QElapsedTimer timer;
+		timer.start();
+		for (quint64 i = 0; i < iterations; ++i) {
+			body();
+		}
+		const qint64 elapsed = timer.nsecsElapsed();
+		if (allocations) {
+			*allocations += g_allocations.load(std::memory_order_relaxed) - allocations_before;
+		}
+		return elapsed;
+	}
+};
+
+// Ответ устройства "$<код><данные><CRC>\r\n"
+QByteArray Reply(const QByteArray& body)
+{
+	return "$" + body + DeviceDriver::CalculateCrc(body) + "\r\n";
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+	QCoreApplication app(argc, argv);
+
+	QCommandLineParser options;
+	options.setApplicationDescription("Protocol codec microbenchmarks.");
+	options.addHelpOption();
+	QCommandLineOption json_option("json", "Print results as JSON.");
+	QCommandLineOption filter_option("filter", "Run only benchmarks whose name contains <text>.", "text");
+	QCommandLineOption time_option("min-time", "Minimum measurement time per benchmark (ms).", "ms", "200");
+	options.addOption(json_option);
+	options.addOption(filter_option);
+	options.addOption(time_option);
+	options.process(app);
+
+	Bench bench(options.value(time_option).toLongLong() * 1000000, options.value(filter_option));
+
+	const DeviceDriver::Counters counters = {3600 * 24 * 90, 1234567};
+	const DeviceDriver::Parameters parameters = {2000, 5000, 10000, 3600, 0xFF, 200};
+
+	QByteArray counters_data(Protocol::HexSize<DeviceDriver::Counters>(), Qt::Uninitialized);
+	QByteArray parameters_data(Protocol::HexSize<DeviceDriver::Parameters>(), Qt::Uninitialized);
+	Protocol::Encode(counters, counters_data.data());
+	Protocol::Encode(parameters, parameters_data.data());
+	const QByteArray characteristics_data = "5D099300";
+
+	const QByteArray counters_reply = Reply("20" + counters_data.toUpper());
+	const QByteArray parameters_reply = Reply("30" + parameters_data.toUpper());
+	const QByteArray parameters_body = "3F" + parameters_data.toUpper();
+
+	bench.Run("CalculateCrc/parameters", parameters_body.size(), [&]() {
+		Keep(DeviceDriver::CalculateCrc(parameters_body));
+	});
+	bench.Run("CheckCrc/counters", counters_reply.size(), [&]() {
+		Keep(DeviceDriver::CheckCrc(counters_reply));
+	});
+	bench.Run("CheckCrc/parameters", parameters_reply.size(), [&]() {
+		Keep(DeviceDriver::CheckCrc(parameters_reply));
+	});
+
+	bench.Run("ExtractBody/parameters", parameters_reply.size(), [&]() {
+		Keep(DeviceDriver::ExtractBody(parameters_reply));
+	});
+	bench.Run("ExtractData/parameters", parameters_reply.size(), [&]() {
+		Keep(DeviceDriver::ExtractData(parameters_reply));
+	});
+	bench.Run("ExtractCrc/parameters", parameters_reply.size(), [&]() {
+		Keep(DeviceDriver::ExtractCrc(parameters_reply));
+	});
+
+	bench.Run("CreatePingMessage", DeviceDriver::CreatePingMessage().size(), [&]() {
+		Keep(DeviceDriver::CreatePingMessage());
+	});
+	bench.Run("CreateReadCountersMessage", DeviceDriver::CreateReadCountersMessage().size(), [&]() {
+		Keep(DeviceDriver::CreateReadCountersMessage());
+	});
+	bench.Run("CreateReadParametersMessage", DeviceDriver::CreateReadParametersMessage().size(), [&]() {
+		Keep(DeviceDriver::CreateReadParametersMessage());
+	});
+	bench.Run("CreateSingleCycleMessage", DeviceDriver::CreateSingleCycleMessage().size(), [&]() {
+		Keep(DeviceDriver::CreateSingleCycleMessage());
+	});
+	bench.Run("CreateWriteCountersMessage",
+			  DeviceDriver::CreateWriteCountersMessage(counters).size(), [&]() {
+		Keep(DeviceDriver::CreateWriteCountersMessage(counters));
+	});
+	bench.Run("CreateWriteParametersMessage",
+			  DeviceDriver::CreateWriteParametersMessage(parameters).size(), [&]() {
+		Keep(DeviceDriver::CreateWriteParametersMessage(parameters));
+	});
+
+	// Кодеки protocol/ в буфер на стеке: без Qt и выделений
+	bench.Run("Counters::Encode", counters_data.size(), [&]() {
+		char buffer[Protocol::HexSize<DeviceDriver::Counters>()];
+		Protocol::Encode(counters, buffer);
+		Keep(buffer);
+	});
+	bench.Run("Counters::Decode", counters_data.size(), [&]() {
+		DeviceDriver::Counters value = {};
+		Keep(Protocol::Decode(counters_data.constData(), counters_data.size(), &value));
+		Keep(value);
+	});
+	bench.Run("Parameters::Encode", parameters_data.size(), [&]() {
+		char buffer[Protocol::HexSize<DeviceDriver::Parameters>()];
+		Protocol::Encode(parameters, buffer);
+		Keep(buffer);
+	});
+	bench.Run("Parameters::Decode", parameters_data.size(), [&]() {
+		DeviceDriver::Parameters value = {};
+		Keep(Protocol::Decode(parameters_data.constData(), parameters_data.size(), &value));
+		Keep(value);
+	});
+	bench.Run("MeasuredCharacteristics::Decode", characteristics_data.size(), [&]() {
+		DeviceDriver::MeasuredCharacteristics value = {};
+		Keep(Protocol::Decode(characteristics_data.constData(), characteristics_data.size(), &value));
+		Keep(value);
+	});
+	// Разбор прямо в кадре ответа, как в DeviceDriver
+	bench.Run("Parameters::Decode/in-frame", parameters_data.size(), [&]() {
+		const auto data = Protocol::ReplyData(parameters_reply.constData(), parameters_reply.size());
+		DeviceDriver::Parameters value = {};
+		Keep(Protocol::Decode(data.data, data.size, &value));
+		Keep(value);
+	});
+	bench.Run("Parameters::Validate", parameters_data.size(), [&]() {
+		Keep(Protocol::Validate(parameters));
+	});
+	bench.Run("BuildRequest/parameters", Protocol::FrameSize(parameters_data.size()), [&]() {
+		char buffer[Protocol::FrameSize(Protocol::HexSize<DeviceDriver::Parameters>())];
+		Keep(Protocol::BuildRequest(Protocol::Opcode::WriteParameters, parameters, buffer));
+		Keep(buffer);
+	});
+	bench.Run("FrameAssembler/parameters", parameters_reply.size(), [&]() {
+		Protocol::FrameAssembler assembler;
+		assembler.Append(parameters_reply.constData(), parameters_reply.size(),
+						 [](const char*, size_t size, bool crc_ok) {
+			Keep(size);
+			Keep(crc_ok);
+		});
+	});
+
+	QTextStream out(stdout);
+	if (options.isSet(json_option)) {
+		QJsonArray results;
+		for (const auto& result : bench.Results()) {
+			results.append(QJsonObject {
+				{"name", result.name},
+				{"iterations", static_cast<double>(result.iterations)},
+				{"ns_per_op", result.ns_per_op},
+				{"allocations_per_op", result.allocations_per_op},
+				{"bytes_per_second", result.bytes_per_second}
+			});
+		}
+		const QJsonObject report {
+			{"qt_version", QString(qVersion())},
+			{"benchmarks", results}
+		};
+		out << QJsonDocument(report).toJson();
+		return 0;
+	}
+
+	out << QString("%1 %2 %3 %4\n")
+		   .arg(QString("benchmark"), -40)
+		   .arg(QString("ns/op"), 10)
+		   .arg(QString("allocs/op"), 10)
+		   .arg(QString("MB/s"), 10);
+	for (const auto& result : bench.Results()) {
+		out << QString("%1 %2 %3 %4\n")
+			   .arg(result.name, -40)
+			   .arg(result.ns_per_op, 10, 'f', 1)
+			   .arg(result.allocations_per_op, 10, 'f', 2)
+			   .arg(result.bytes_per_second / 1e6, 10, 'f', 1);
+	}
+	return 0;
+}
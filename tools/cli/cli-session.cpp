@@ -0,0 +1,405 @@
+#include "cli-session.h"
+#include "device-discovery.h"
+
+#include <QDateTime>
+#include <QTextStream>
+
+#include <limits>
+
+namespace {
+
+QString Hex(quint16 value)
+{
+	return QString("%1").arg(value, 4, 16, QChar('0'));
+}
+
+void PrintError(const QString& message)
+{
+	QTextStream(stderr) << message << "\n";
+}
+
+}
+
+CliSession::CliSession(const Options& options, RecordWriter* writer, QObject *parent)
+	: QObject(parent)
+	, _options(options)
+	, _writer(writer)
+	, _driver()
+	, _fleet(nullptr)
+	, _read_before_write(false)
+	, _written_counters({})
+	, _written_parameters({})
+	, _samples(0)
+{
+	connect(&_driver, &DeviceDriver::Event, this, &CliSession::HandleEvent);
+	connect(&_driver, &DeviceDriver::Trace, this, [](const QString& message) {
+		PrintError(message);
+	});
+	if (_options.verbose) {
+		connect(&_driver, &DeviceDriver::TraceFrame, this, [](Tracing::Direction direction, const QByteArray& frame) {
+			PrintError((direction == Tracing::Direction::Out ? "out > " : "in   < ") + QString::fromLatin1(frame.trimmed()));
+		});
+	}
+}
+
+bool CliSession::ParseCommand(const QString& name, Command* command)
+{
+	static const QMap<QString, Command> kCommands = {
+		{"scan", Command::Scan},
+		{"read-counters", Command::ReadCounters},
+		{"write-counters", Command::WriteCounters},
+		{"read-parameters", Command::ReadParameters},
+		{"write-parameters", Command::WriteParameters},
+		{"cycle", Command::SingleCycle},
+		{"stream", Command::Stream},
+		{"rollout", Command::Rollout}
+	};
+
+	const auto it = kCommands.find(name);
+	if (it == kCommands.end()) {
+		return false;
+	}
+	*command = it.value();
+	return true;
+}
+
+QStringList CliSession::FieldNames(Command command)
+{
+	switch (command) {
+	case Command::WriteCounters:
+		return {"time", "cycles"};
+	case Command::WriteParameters:
+	case Command::Rollout:
+		return {"cpm", "tp", "tbc", "tbtp", "ct", "tw"};
+	default:
+		return {};
+	}
+}
+
+uint CliSession::FieldMax(const QString& name)
+{
+	typedef DeviceDriver::Counters Counters;
+	typedef DeviceDriver::Parameters Parameters;
+	static const QMap<QString, uint> kMax = {
+		{"time", std::numeric_limits<decltype(Counters::time)>::max()},
+		{"cycles", std::numeric_limits<decltype(Counters::cycles)>::max()},
+		{"cpm", std::numeric_limits<decltype(Parameters::cpm)>::max()},
+		{"tp", std::numeric_limits<decltype(Parameters::tp)>::max()},
+		{"tbc", std::numeric_limits<decltype(Parameters::tbc)>::max()},
+		{"tbtp", std::numeric_limits<decltype(Parameters::tbtp)>::max()},
+		{"ct", std::numeric_limits<decltype(Parameters::ct)>::max()},
+		{"tw", std::numeric_limits<decltype(Parameters::tw)>::max()}
+	};
+	return kMax.value(name);
+}
+
+// Значения уже проверены по FieldMax, сужение типа их не искажает
+DeviceDriver::Parameters CliSession::MergeParameters(const QMap<QString, uint>& values,
+													 const DeviceDriver::Parameters& base)
+{
+	DeviceDriver::Parameters parameters = base;
+	parameters.cpm = static_cast<uint16_t>(values.value("cpm", parameters.cpm));
+	parameters.tp = static_cast<uint16_t>(values.value("tp", parameters.tp));
+	parameters.tbc = static_cast<uint16_t>(values.value("tbc", parameters.tbc));
+	parameters.tbtp = static_cast<uint16_t>(values.value("tbtp", parameters.tbtp));
+	parameters.ct = static_cast<uint8_t>(values.value("ct", parameters.ct));
+	parameters.tw = static_cast<uint16_t>(values.value("tw", parameters.tw));
+	return parameters;
+}
+
+void CliSession::Start()
+{
+	// Сначала все устройства подключаются параллельно, затем операция группы
+	if (_options.command == Command::Scan || _options.command == Command::Rollout) {
+		const auto ports = DeviceDiscovery::AvailablePorts();
+		for (const auto& info : ports) {
+			_scan_ports.insert(info.portName(), info);
+		}
+		// Пути вне списка Qt описания не имеют, ключ - сам путь, как в DeviceFleet
+		for (const auto& path : DeviceDiscovery::ExtraPorts()) {
+			_scan_ports.insert(path, QSerialPortInfo());
+		}
+
+		_fleet = new DeviceFleet(this);
+		connect(_fleet, &DeviceFleet::OperationFinished, this, &CliSession::HandleFleet);
+		connect(_fleet, &DeviceFleet::RolloutFinished, this, &CliSession::HandleRollout);
+		_fleet->Discover();
+		return;
+	}
+
+	if (_options.port.isEmpty()) {
+		_driver.FindDevice();
+	} else {
+		_driver.ConnectPort(_options.port);
+	}
+}
+
+void CliSession::HandleEvent(DeviceDriver::EventCode event)
+{
+	switch (event) {
+	case DeviceDriver::EventCode::DeviceFound:
+		RunCommand();
+		break;
+
+	case DeviceDriver::EventCode::DeviceNotFound:
+		Fail("device not found", ExitNotFound);
+		break;
+
+	case DeviceDriver::EventCode::DeviceDisconnected:
+		Fail("device disconnected", ExitDeviceError);
+		break;
+
+	case DeviceDriver::EventCode::ReadCountersSuccess:
+		if (_read_before_write) {
+			WriteMerged();
+			break;
+		}
+		PrintCounters(_driver.GetCounters());
+		Finish(ExitOk);
+		break;
+
+	case DeviceDriver::EventCode::ReadParametersSuccess:
+		if (_read_before_write) {
+			WriteMerged();
+			break;
+		}
+		PrintParameters(_driver.GetParameters());
+		Finish(ExitOk);
+		break;
+
+	case DeviceDriver::EventCode::WriteCountersSuccess:
+		PrintCounters(_written_counters);
+		Finish(ExitOk);
+		break;
+
+	case DeviceDriver::EventCode::WriteParametersSuccess:
+		PrintParameters(_written_parameters);
+		Finish(ExitOk);
+		break;
+
+	case DeviceDriver::EventCode::LaunchSingleCycleSuccess:
+		PrintCharacteristics(_driver.GetCharacteristics());
+		Finish(ExitOk);
+		break;
+
+	case DeviceDriver::EventCode::TelemetrySampled:
+		DrainTelemetry();
+		break;
+
+	case DeviceDriver::EventCode::ReadCountersError:
+		Fail("read counters failed", ExitDeviceError);
+		break;
+	case DeviceDriver::EventCode::WriteCountersError:
+		Fail("write counters failed", ExitDeviceError);
+		break;
+	case DeviceDriver::EventCode::ReadParametersError:
+		Fail("read parameters failed", ExitDeviceError);
+		break;
+	case DeviceDriver::EventCode::WriteParametersError:
+		Fail("write parameters failed", ExitDeviceError);
+		break;
+	case DeviceDriver::EventCode::LaunchSingleCycleError:
+		Fail("single cycle failed", ExitDeviceError);
+		break;
+	case DeviceDriver::EventCode::TelemetryError:
+		Fail("telemetry failed", ExitDeviceError);
+		break;
+
+	case DeviceDriver::EventCode::ReadSnapshotSuccess:
+	case DeviceDriver::EventCode::ReadSnapshotError:
+		break;
+	}
+}
+
+void CliSession::HandleFleet(DeviceFleet::Operation operation, const DeviceFleet::Results& results, qint64 elapsed_ms)
+{
+	if (operation != DeviceFleet::Operation::Discover) {
+		return;
+	}
+
+	if (_options.command == Command::Scan) {
+		PrintScan(results, elapsed_ms);
+		return;
+	}
+
+	if (_fleet->Ports().isEmpty()) {
+		Fail("device not found", ExitNotFound);
+	} else if (_options.profiles.isEmpty()) {
+		_fleet->RolloutProfile(MergeParameters(_options.values, {}));
+	} else {
+		_fleet->Rollout(_options.profiles);
+	}
+}
+
+void CliSession::HandleRollout(const DeviceFleet::RolloutReport& report, qint64 elapsed_ms)
+{
+	int passed = 0;
+	for (auto it = report.cbegin(); it != report.cend(); ++it) {
+		const auto& result = it.value();
+		passed += result.passed ? 1 : 0;
+		_writer->Write("rollout", {
+			{"port", it.key()},
+			{"passed", result.passed},
+			{"error", result.error},
+			{"mismatches", result.mismatches.join("; ")},
+			{"write_ms", result.write_ms},
+			{"verify_ms", result.verify_ms}
+		});
+	}
+	_writer->Write("summary", {
+		{"devices", report.size()},
+		{"passed", passed},
+		{"failed", report.size() - passed},
+		{"elapsed_ms", elapsed_ms}
+	});
+	Finish(passed == report.size() ? ExitOk : ExitDeviceError);
+}
+
+void CliSession::PrintScan(const DeviceFleet::Results& results, qint64 elapsed_ms)
+{
+	for (auto it = _scan_ports.cbegin(); it != _scan_ports.cend(); ++it) {
+		const auto& info = it.value();
+		const bool has_usb = info.hasVendorIdentifier() && info.hasProductIdentifier();
+		_writer->Write("port", {
+			{"port", it.key()},
+			{"description", info.description()},
+			{"vid", has_usb ? Hex(info.vendorIdentifier()) : QString()},
+			{"pid", has_usb ? Hex(info.productIdentifier()) : QString()},
+			{"serial", info.serialNumber()},
+			{"device", results.value(it.key()) == DeviceDriver::EventCode::DeviceFound}
+		});
+	}
+	_writer->Write("scan", {
+		{"ports", _scan_ports.size()},
+		{"devices", _fleet->Ports().size()},
+		{"elapsed_ms", elapsed_ms}
+	});
+	Finish(ExitOk);
+}
+
+void CliSession::RunCommand()
+{
+	switch (_options.command) {
+	case Command::Scan:
+	case Command::Rollout:
+		break;
+
+	case Command::ReadCounters:
+		_driver.ReadCounters();
+		break;
+
+	case Command::ReadParameters:
+		_driver.ReadParameters();
+		break;
+
+	// Поля, не заданные в командной строке, берутся из устройства
+	case Command::WriteCounters:
+	case Command::WriteParameters:
+		if (_options.values.size() == FieldNames(_options.command).size()) {
+			WriteMerged();
+		} else {
+			_read_before_write = true;
+			if (_options.command == Command::WriteCounters) {
+				_driver.ReadCounters();
+			} else {
+				_driver.ReadParameters();
+			}
+		}
+		break;
+
+	case Command::SingleCycle:
+		_driver.LaunchSingleCycle();
+		break;
+
+	case Command::Stream:
+		_driver.StartPolling(_options.interval_ms, _options.sources);
+		break;
+	}
+}
+
+void CliSession::WriteMerged()
+{
+	_read_before_write = false;
+	const auto& values = _options.values;
+
+	if (_options.command == Command::WriteCounters) {
+		auto counters = _driver.GetCounters();
+		counters.time = values.value("time", counters.time);
+		counters.cycles = values.value("cycles", counters.cycles);
+		_written_counters = counters;
+		_driver.WriteCounters(counters);
+		return;
+	}
+
+	_written_parameters = MergeParameters(values, _driver.GetParameters());
+	_driver.WriteParameters(_written_parameters);
+}
+
+void CliSession::DrainTelemetry()
+{
+	QVector<DeviceDriver::TelemetrySample> samples;
+	_driver.DrainTelemetry(samples);
+
+	for (const auto& sample : samples) {
+		RecordWriter::Fields fields = {
+			{"timestamp", QDateTime::fromMSecsSinceEpoch(sample.timestamp).toString(Qt::ISODateWithMs)}
+		};
+		if (sample.sources & DeviceDriver::TelemetryCounters) {
+			fields.append({"time", sample.counters.time});
+			fields.append({"cycles", sample.counters.cycles});
+		}
+		if (sample.sources & DeviceDriver::TelemetrySingleCycle) {
+			fields.append({"voltage", sample.characteristics.vlt * Protocol::kVoltageScale});
+			fields.append({"current", sample.characteristics.curr * Protocol::kCurrentScale});
+		}
+		_writer->Write("sample", fields);
+
+		++_samples;
+		if (_options.count > 0 && _samples >= _options.count) {
+			_driver.StopPolling();
+			Finish(ExitOk);
+			return;
+		}
+	}
+}
+
+void CliSession::Finish(int exit_code)
+{
+	// После итога команды драйвер ещё может прислать события, они не нужны
+	_driver.disconnect(this);
+	emit Finished(exit_code);
+}
+
+void CliSession::Fail(const QString& message, int exit_code)
+{
+	PrintError(message);
+	Finish(exit_code);
+}
+
+void CliSession::PrintCounters(const DeviceDriver::Counters& counters)
+{
+	_writer->Write("counters", {
+		{"time", counters.time},
+		{"cycles", counters.cycles}
+	});
+}
+
+void CliSession::PrintParameters(const DeviceDriver::Parameters& parameters)
+{
+	_writer->Write("parameters", {
+		{"cpm", parameters.cpm},
+		{"tp", parameters.tp},
+		{"tbc", parameters.tbc},
+		{"tbtp", parameters.tbtp},
+		{"ct", parameters.ct},
+		{"tw", parameters.tw}
+	});
+}
+
+void CliSession::PrintCharacteristics(const DeviceDriver::MeasuredCharacteristics& characteristics)
+{
+	_writer->Write("cycle", {
+		{"voltage", characteristics.vlt * Protocol::kVoltageScale},
+		{"current", characteristics.curr * Protocol::kCurrentScale}
+	});
+}
@@ -0,0 +1,97 @@
+#ifndef CLISESSION_H
+#define CLISESSION_H
+
+#include "device-driver.h"
+#include "device-fleet.h"
+#include "record-writer.h"
+
+#include <QMap>
+#include <QObject>
+#include <QSerialPortInfo>
+
+// Одна команда командной строки: подключение, обмен, вывод результата.
+// Драйвер работает в главном потоке, его события обрабатываются по мере
+// прихода, по окончании испускается Finished с кодом завершения.
+class CliSession : public QObject
+{
+	Q_OBJECT
+
+public:
+	enum class Command {
+		Scan,
+		ReadCounters,
+		WriteCounters,
+		ReadParameters,
+		WriteParameters,
+		SingleCycle,
+		Stream,
+		Rollout
+	};
+
+	// Коды завершения процесса
+	enum ExitCode {
+		ExitOk = 0,
+		ExitUsage = 1,
+		ExitNotFound = 2,
+		ExitDeviceError = 3
+	};
+
+	struct Options {
+		Command command;
+		QString port; // пусто - поиск устройства по всем портам
+		QMap<QString, uint> values; // поля для записи, остальные сохраняются
+		// Rollout: параметры по портам, пусто - values на все устройства
+		QMap<QString, DeviceDriver::Parameters> profiles;
+		int interval_ms; // период опроса для Stream
+		int count; // число отсчётов Stream, 0 - до прерывания
+		int sources; // DeviceDriver::TelemetrySource
+		bool verbose;
+	};
+
+public:
+	CliSession(const Options&, RecordWriter*, QObject *parent = nullptr);
+
+	static bool ParseCommand(const QString&, Command*);
+	// Имена полей, допустимые для команды записи
+	static QStringList FieldNames(Command);
+	// Наибольшее значение поля по его ширине в структуре устройства
+	static uint FieldMax(const QString& name);
+	// Параметры из полей values, недостающие берутся из base
+	static DeviceDriver::Parameters MergeParameters(const QMap<QString, uint>& values,
+													const DeviceDriver::Parameters& base);
+
+public slots:
+	void Start();
+
+signals:
+	void Finished(int exit_code);
+
+private:
+	Options _options;
+	RecordWriter* _writer;
+	DeviceDriver _driver;
+	DeviceFleet* _fleet;
+	QMap<QString, QSerialPortInfo> _scan_ports;
+	bool _read_before_write;
+	// Записанные значения: драйвер после записи их не перечитывает
+	DeviceDriver::Counters _written_counters;
+	DeviceDriver::Parameters _written_parameters;
+	int _samples;
+
+private:
+	void HandleEvent(DeviceDriver::EventCode);
+	void HandleFleet(DeviceFleet::Operation, const DeviceFleet::Results&, qint64 elapsed_ms);
+	void HandleRollout(const DeviceFleet::RolloutReport&, qint64 elapsed_ms);
+	void PrintScan(const DeviceFleet::Results&, qint64 elapsed_ms);
+	void RunCommand();
+	void WriteMerged();
+	void DrainTelemetry();
+	void Finish(int exit_code);
+	void Fail(const QString&, int exit_code);
+
+	void PrintCounters(const DeviceDriver::Counters&);
+	void PrintParameters(const DeviceDriver::Parameters&);
+	void PrintCharacteristics(const DeviceDriver::MeasuredCharacteristics&);
+};
+
+#endif // CLISESSION_H
@@ -0,0 +1,43 @@
+QT -= gui
+QT += core serialport
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TARGET = archipelago-cli
+
+INCLUDEPATH += ../..
+
+include(../../protocol/protocol.pri)
+
+SOURCES += \
+    ../../capture-file.cpp \
+    ../../device-discovery.cpp \
+    ../../device-driver.cpp \
+    ../../device-fleet.cpp \
+    ../../device-stats.cpp \
+    ../../frame-parser.cpp \
+    ../../port-cache.cpp \
+    ../../port-watcher.cpp \
+    cli-session.cpp \
+    main.cpp \
+    record-writer.cpp
+
+HEADERS += \
+    ../../capture-file.h \
+    ../../device-commands.h \
+    ../../device-discovery.h \
+    ../../device-driver.h \
+    ../../device-fleet.h \
+    ../../device-stats.h \
+    ../../field-cache.h \
+    ../../frame-parser.h \
+    ../../latency-histogram.h \
+    ../../port-cache.h \
+    ../../port-watcher.h \
+    ../../ring-buffer.h \
+    ../../rtt-estimator.h \
+    ../../seqlock.h \
+    ../../tracing.h \
+    cli-session.h \
+    record-writer.h
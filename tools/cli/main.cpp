@@ -0,0 +1,239 @@
+// Работа с устройством из командной строки, без окна и виджетов: для
+// сценариев и стендов без графики. Использует тот же DeviceDriver.
+
+#include "cli-session.h"
+#include "record-writer.h"
+#include "tracing.h"
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QFile>
+#include <QTextStream>
+
+namespace {
+
+const int kDefaultInterval = 1000; // период опроса stream по умолчанию (мс)
+
+// Значения "имя=число" для команд записи; число десятичное или 0x...
+bool ParseValues(const QStringList& arguments, CliSession::Command command, QMap<QString, uint>* values, QString* error)
+{
+	const auto names = CliSession::FieldNames(command);
+	for (const auto& argument : arguments) {
+		const int separator = argument.indexOf('=');
+		const QString name = argument.left(separator);
+		if (separator < 0 || !names.contains(name)) {
+			*error = "unknown field: " + argument + " (expected " + names.join(", ") + ")";
+			return false;
+		}
+
+		bool ok = false;
+		const uint value = argument.mid(separator + 1).toUInt(&ok, 0);
+		if (!ok) {
+			*error = "invalid value: " + argument;
+			return false;
+		}
+		// Иначе приведение к ширине поля молча запишет другое число
+		if (value > CliSession::FieldMax(name)) {
+			*error = QString("value out of range: %1 (max %2)").arg(argument).arg(CliSession::FieldMax(name));
+			return false;
+		}
+		values->insert(name, value);
+	}
+	return true;
+}
+
+// Параметры по устройствам: строка заголовка с колонками port, cpm, tp,
+// tbc, tbtp, ct, tw в любом порядке, затем по строке на порт
+bool LoadProfiles(const QString& path, QMap<QString, DeviceDriver::Parameters>* profiles, QString* error)
+{
+	QFile file(path);
+	if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+		*error = "cannot open " + path;
+		return false;
+	}
+
+	const auto names = CliSession::FieldNames(CliSession::Command::Rollout);
+	const QStringList columns = QStringList(names) << "port";
+	QStringList header;
+	int line_number = 0;
+	while (!file.atEnd()) {
+		++line_number;
+		const QString line = QString::fromUtf8(file.readLine()).trimmed();
+		if (line.isEmpty() || line.startsWith('#')) {
+			continue;
+		}
+
+		QStringList cells = line.split(',');
+		for (auto& cell : cells) {
+			cell = cell.trimmed();
+		}
+
+		if (header.isEmpty()) {
+			header = cells;
+			for (const auto& column : columns) {
+				if (!header.contains(column)) {
+					*error = path + ": missing column " + column;
+					return false;
+				}
+			}
+			continue;
+		}
+
+		if (cells.size() != header.size()) {
+			*error = QString("%1:%2: expected %3 columns").arg(path).arg(line_number).arg(header.size());
+			return false;
+		}
+
+		QMap<QString, uint> values;
+		for (const auto& name : names) {
+			bool ok = false;
+			const uint value = cells.at(header.indexOf(name)).toUInt(&ok, 0);
+			if (!ok || value > CliSession::FieldMax(name)) {
+				*error = QString("%1:%2: invalid %3").arg(path).arg(line_number).arg(name);
+				return false;
+			}
+			values.insert(name, value);
+		}
+		const auto parameters = CliSession::MergeParameters(values, {});
+		QString invalid;
+		if (!DeviceDriver::Validate(parameters, &invalid)) {
+			*error = QString("%1:%2: %3").arg(path).arg(line_number).arg(invalid);
+			return false;
+		}
+		profiles->insert(cells.at(header.indexOf("port")), parameters);
+	}
+
+	if (profiles->isEmpty()) {
+		*error = path + ": no devices";
+		return false;
+	}
+	return true;
+}
+
+bool ParseSources(const QString& text, int* sources)
+{
+	*sources = 0;
+	const auto names = text.split(',', Qt::SkipEmptyParts);
+	for (const auto& name : names) {
+		if (name == "counters") {
+			*sources |= DeviceDriver::TelemetryCounters;
+		} else if (name == "cycle") {
+			*sources |= DeviceDriver::TelemetrySingleCycle;
+		} else {
+			return false;
+		}
+	}
+	return *sources != 0;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+	QCoreApplication app(argc, argv);
+	// Кэш портов и настройки общие с графическим приложением
+	QCoreApplication::setOrganizationName("Archipelago");
+	QCoreApplication::setApplicationName("archipelago");
+
+	QCommandLineParser options;
+	options.setApplicationDescription("Talks to the pump controller without the GUI.\n\n"
+									  "Commands:\n"
+									  "  scan                        list ports and probe each for a device\n"
+									  "  read-counters\n"
+									  "  write-counters [time=N] [cycles=N]\n"
+									  "  read-parameters\n"
+									  "  write-parameters [cpm=N] [tp=N] [tbc=N] [tbtp=N] [ct=N] [tw=N]\n"
+									  "  cycle                       launch a single cycle, print voltage and current\n"
+									  "  stream                      poll telemetry until --count samples or Ctrl+C\n"
+									  "  rollout cpm=N tp=N tbc=N tbtp=N ct=N tw=N\n"
+									  "  rollout --profiles <file>   write parameters to every device at once,\n"
+									  "                              read them back and report pass/fail\n\n"
+									  "Fields left out of a write keep the values read from the device.\n"
+									  "The profiles file is CSV with a header: port,cpm,tp,tbc,tbtp,ct,tw.");
+	options.addHelpOption();
+	options.addPositionalArgument("command", "Command to run, see above.");
+	options.addPositionalArgument("fields", "name=value pairs for write commands.", "[fields...]");
+	QCommandLineOption port_option({"p", "port"}, "Use <port> instead of searching all ports.", "port");
+	QCommandLineOption format_option({"f", "format"}, "Output format: text, json or csv.", "format", "text");
+	QCommandLineOption interval_option({"i", "interval"}, "Stream polling period in ms.", "ms", QString::number(kDefaultInterval));
+	QCommandLineOption count_option({"n", "count"}, "Stop streaming after <n> samples.", "n", "0");
+	QCommandLineOption sources_option("sources", "Stream sources: counters, cycle or both.", "list", "counters");
+	QCommandLineOption profiles_option("profiles", "Per-device rollout parameters from CSV <file>.", "file");
+	QCommandLineOption verbose_option({"v", "verbose"}, "Trace serial traffic to stderr.");
+	options.addOption(port_option);
+	options.addOption(format_option);
+	options.addOption(interval_option);
+	options.addOption(count_option);
+	options.addOption(sources_option);
+	options.addOption(profiles_option);
+	options.addOption(verbose_option);
+	options.process(app);
+
+	QTextStream err(stderr);
+	const auto arguments = options.positionalArguments();
+
+	CliSession::Options session_options = {};
+	if (arguments.isEmpty() || !CliSession::ParseCommand(arguments.first(), &session_options.command)) {
+		options.showHelp(CliSession::ExitUsage);
+	}
+
+	QString error;
+	if (!ParseValues(arguments.mid(1), session_options.command, &session_options.values, &error)) {
+		err << error << "\n";
+		return CliSession::ExitUsage;
+	}
+
+	if (session_options.command == CliSession::Command::Rollout) {
+		const bool from_file = options.isSet(profiles_option);
+		if (from_file && !session_options.values.isEmpty()) {
+			err << "rollout takes either fields or --profiles\n";
+			return CliSession::ExitUsage;
+		}
+		// Профиль на все устройства должен быть полным: дописывать нечем
+		if (!from_file && session_options.values.size() != CliSession::FieldNames(session_options.command).size()) {
+			err << "rollout needs all of " << CliSession::FieldNames(session_options.command).join(", ") << "\n";
+			return CliSession::ExitUsage;
+		}
+		if (!from_file && !DeviceDriver::Validate(CliSession::MergeParameters(session_options.values, {}), &error)) {
+			err << error << "\n";
+			return CliSession::ExitUsage;
+		}
+		if (from_file && !LoadProfiles(options.value(profiles_option), &session_options.profiles, &error)) {
+			err << error << "\n";
+			return CliSession::ExitUsage;
+		}
+	}
+
+	RecordWriter::Format format = RecordWriter::Text;
+	if (!RecordWriter::ParseFormat(options.value(format_option), &format)) {
+		err << "unknown format: " << options.value(format_option) << "\n";
+		return CliSession::ExitUsage;
+	}
+
+	bool interval_ok = false;
+	bool count_ok = false;
+	session_options.port = options.value(port_option);
+	session_options.interval_ms = options.value(interval_option).toInt(&interval_ok);
+	session_options.count = options.value(count_option).toInt(&count_ok);
+	session_options.verbose = options.isSet(verbose_option);
+	if (!interval_ok || session_options.interval_ms <= 0 || !count_ok || session_options.count < 0) {
+		err << "invalid --interval or --count\n";
+		return CliSession::ExitUsage;
+	}
+	if (!ParseSources(options.value(sources_option), &session_options.sources)) {
+		err << "invalid --sources: " << options.value(sources_option) << "\n";
+		return CliSession::ExitUsage;
+	}
+
+	if (session_options.verbose) {
+		Tracing::SetLevel(Tracing::Level::Debug);
+	}
+
+	RecordWriter writer(format);
+	CliSession session(session_options, &writer);
+	QObject::connect(&session, &CliSession::Finished, &app, &QCoreApplication::exit);
+	// Запуск из цикла событий: иначе быстрый отказ (нет портов) завершит
+	// приложение ещё до exec()
+	QMetaObject::invokeMethod(&session, &CliSession::Start, Qt::QueuedConnection);
+	return app.exec();
+}
@@ -0,0 +1,78 @@
+#include "record-writer.h"
+
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include <cstdio>
+
+RecordWriter::RecordWriter(Format format)
+	: _format(format)
+	, _out(stdout)
+{
+}
+
+bool RecordWriter::ParseFormat(const QString& name, Format* format)
+{
+	if (name == "text") {
+		*format = Text;
+	} else if (name == "json") {
+		*format = Json;
+	} else if (name == "csv") {
+		*format = Csv;
+	} else {
+		return false;
+	}
+	return true;
+}
+
+void RecordWriter::Write(const QString& kind, const Fields& fields)
+{
+	switch (_format) {
+	case Text: {
+		_out << kind;
+		for (const auto& field : fields) {
+			_out << " " << field.first << "=" << field.second.toString();
+		}
+		_out << "\n";
+	}
+		break;
+
+	case Json: {
+		QJsonObject object;
+		object.insert("record", kind);
+		for (const auto& field : fields) {
+			object.insert(field.first, QJsonValue::fromVariant(field.second));
+		}
+		_out << QJsonDocument(object).toJson(QJsonDocument::Compact) << "\n";
+	}
+		break;
+
+	case Csv: {
+		QStringList header("record");
+		QStringList values(kind);
+		for (const auto& field : fields) {
+			header.append(field.first);
+			values.append(CsvValue(field.second));
+		}
+		if (header != _csv_header) {
+			_csv_header = header;
+			_out << header.join(',') << "\n";
+		}
+		_out << values.join(',') << "\n";
+	}
+		break;
+	}
+
+	// Потребитель может читать вывод потоковой команды по мере появления
+	_out.flush();
+}
+
+QString RecordWriter::CsvValue(const QVariant& value)
+{
+	QString text = value.toString();
+	if (text.contains(',') || text.contains('"') || text.contains('\n')) {
+		text.replace("\"", "\"\"");
+		text = "\"" + text + "\"";
+	}
+	return text;
+}
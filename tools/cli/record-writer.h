@@ -0,0 +1,40 @@
+#ifndef RECORDWRITER_H
+#define RECORDWRITER_H
+
+#include <QList>
+#include <QPair>
+#include <QString>
+#include <QTextStream>
+#include <QVariant>
+
+// Вывод результатов построчно: текст "вид ключ=значение", JSON Lines
+// или CSV. В CSV заголовок печатается заново, когда меняется набор полей.
+class RecordWriter
+{
+public:
+	enum Format {
+		Text,
+		Json,
+		Csv
+	};
+
+	typedef QList<QPair<QString, QVariant>> Fields;
+
+public:
+	explicit RecordWriter(Format);
+
+	// false - неизвестное имя формата
+	static bool ParseFormat(const QString&, Format*);
+
+	void Write(const QString& kind, const Fields&);
+
+private:
+	Format _format;
+	QTextStream _out;
+	QStringList _csv_header;
+
+private:
+	static QString CsvValue(const QVariant&);
+};
+
+#endif // RECORDWRITER_H
@@ -0,0 +1,181 @@
+// Воспроизведение записи обмена (--capture): куски из порта в исходном
+// порядке и с исходными паузами подаются в FrameParser, ответы разбираются
+// библиотекой protocol/, как и в DeviceDriver.
+
+#include "capture-file.h"
+#include "frame-codec.h"
+#include "frame-parser.h"
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHash>
+#include <QTextStream>
+
+#include <chrono>
+#include <thread>
+
+namespace {
+
+struct PortState {
+	QString name;
+	FrameParser parser;
+};
+
+struct Totals {
+	quint64 records = 0;
+	quint64 bytes_out = 0;
+	quint64 bytes_in = 0;
+	quint64 frames = 0;
+	quint64 crc_errors = 0;
+};
+
+QString Describe(const QByteArray& raw)
+{
+	// Разбор прямо по кадру, как в DeviceDriver; неверные данные дают нули
+	const auto data = Protocol::ReplyData(raw.constData(), static_cast<size_t>(raw.size()));
+	Protocol::Opcode code;
+	if (!Protocol::FrameCode(raw.constData(), static_cast<size_t>(raw.size()), &code)) {
+		return QString();
+	}
+
+	switch (code) {
+	case Protocol::Opcode::ReadCounters: {
+		Protocol::Counters counters = {};
+		Protocol::Decode(data.data, data.size, &counters);
+		return QString("counters time=%1 cycles=%2").arg(counters.time).arg(counters.cycles);
+	}
+	case Protocol::Opcode::ReadParameters: {
+		Protocol::Parameters parameters = {};
+		Protocol::Decode(data.data, data.size, &parameters);
+		return QString("parameters cpm=%1 tp=%2 tbc=%3 tbtp=%4 ct=%5 tw=%6")
+				.arg(parameters.cpm).arg(parameters.tp).arg(parameters.tbc)
+				.arg(parameters.tbtp).arg(parameters.ct).arg(parameters.tw);
+	}
+	case Protocol::Opcode::SingleCycle: {
+		Protocol::MeasuredCharacteristics characteristics = {};
+		Protocol::Decode(data.data, data.size, &characteristics);
+		return QString("characteristics vlt=%1 curr=%2").arg(characteristics.vlt).arg(characteristics.curr);
+	}
+	default:
+		return QString();
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	QCoreApplication app(argc, argv);
+
+	QCommandLineParser options;
+	options.setApplicationDescription("Replays a serial traffic capture through the frame parser.");
+	options.addHelpOption();
+	options.addPositionalArgument("capture", "Capture file recorded with --capture.");
+	QCommandLineOption fast_option("fast", "Ignore recorded timing, replay as fast as possible.");
+	QCommandLineOption quiet_option("quiet", "Print only the summary.");
+	options.addOption(fast_option);
+	options.addOption(quiet_option);
+	options.process(app);
+
+	QTextStream out(stdout);
+	QTextStream err(stderr);
+
+	if (options.positionalArguments().size() != 1) {
+		options.showHelp(1);
+	}
+
+	QFile file(options.positionalArguments().first());
+	if (!file.open(QIODevice::ReadOnly)) {
+		err << "cannot open " << file.fileName() << "\n";
+		return 1;
+	}
+
+	// Файл отображается в память целиком, записи читаются без копирования
+	const auto size = file.size();
+	const uchar* data = size > 0 ? file.map(0, size) : nullptr;
+	Capture::Reader reader;
+	if (!reader.Open(data, static_cast<size_t>(size))) {
+		err << "not a capture file: " << file.fileName() << "\n";
+		return 1;
+	}
+
+	const bool fast = options.isSet(fast_option);
+	const bool quiet = options.isSet(quiet_option);
+
+	QHash<quint16, PortState> ports;
+	Totals totals;
+	const auto start = std::chrono::steady_clock::now();
+	QElapsedTimer elapsed;
+	elapsed.start();
+
+	Capture::Record record;
+	while (reader.Next(record)) {
+		++totals.records;
+
+		if (!fast) {
+			std::this_thread::sleep_until(start + std::chrono::nanoseconds(record.timestamp_ns));
+		}
+
+		auto& port = ports[record.port];
+		const auto bytes = QByteArray::fromRawData(reinterpret_cast<const char*>(record.data),
+												   static_cast<int>(record.size));
+		const QString time = QString::number(record.timestamp_ns / 1000000.0, 'f', 3);
+
+		switch (record.type) {
+		case Capture::PortName:
+			port.name = QString::fromUtf8(bytes);
+			break;
+
+		case Capture::Transmit:
+			totals.bytes_out += record.size;
+			if (!quiet) {
+				out << time << "ms " << port.name << " out > " << bytes.trimmed() << "\n";
+			}
+			break;
+
+		case Capture::Receive:
+			totals.bytes_in += record.size;
+			port.parser.Append(bytes);
+			while (port.parser.HasFrame()) {
+				const auto frame = port.parser.TakeFrame();
+				++totals.frames;
+				if (!frame.crc_ok) {
+					++totals.crc_errors;
+				}
+				if (!quiet) {
+					out << time << "ms " << port.name << " in   < " << frame.raw.trimmed();
+					if (!frame.crc_ok) {
+						out << " [crc error]";
+					} else {
+						const auto description = Describe(frame.raw);
+						if (!description.isEmpty()) {
+							out << " " << description;
+						}
+					}
+					out << "\n";
+				}
+			}
+			break;
+		}
+
+		if (!fast) {
+			out.flush();
+		}
+	}
+
+	const double seconds = elapsed.nsecsElapsed() / 1e9;
+	out << "records: " << totals.records
+		<< ", out: " << totals.bytes_out << " B"
+		<< ", in: " << totals.bytes_in << " B"
+		<< ", frames: " << totals.frames
+		<< ", crc errors: " << totals.crc_errors << "\n";
+	out << "replayed in " << QString::number(seconds, 'f', 3) << " s";
+	if (fast && seconds > 0) {
+		out << " (" << QString::number(totals.bytes_in / seconds / 1e6, 'f', 2) << " MB/s)";
+	}
+	out << "\n";
+	if (reader.IsTruncated()) {
+		err << "warning: last record is truncated\n";
+	}
+	return 0;
+}
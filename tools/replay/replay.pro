@@ -0,0 +1,20 @@
+QT -= gui
+QT += core
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TARGET = archipelago-replay
+
+INCLUDEPATH += ../..
+
+include(../../protocol/protocol.pri)
+
+SOURCES += \
+    ../../capture-file.cpp \
+    ../../frame-parser.cpp \
+    main.cpp
+
+HEADERS += \
+    ../../capture-file.h \
+    ../../frame-parser.h
@@ -0,0 +1,243 @@
+// Виртуальные контроллеры на псевдотерминалах Linux. Каждый экземпляр -
+// отдельный PTY, путь к нему печатается при запуске. Порты можно передать
+// программе через ARCHIPELAGO_EXTRA_PORTS, чтобы их нашёл FindDevice.
+
+#include "virtual-device.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <getopt.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+struct Pending {
+	Clock::time_point due;
+	std::string bytes;
+};
+
+struct Instance {
+	int master;
+	int slave; // держится открытым, чтобы master не получал HUP без клиента
+	std::string path;
+	std::string link;
+	VirtualDevice device;
+	std::deque<Pending> pending; // ответы по возрастанию due
+	std::string output; // недописанный хвост ответа
+};
+
+volatile std::sig_atomic_t g_stop = 0;
+
+void Stop(int)
+{
+	g_stop = 1;
+}
+
+void Usage(const char* program)
+{
+	std::fprintf(stderr,
+				 "Usage: %s [options]\n"
+				 "  -n, --count N       number of virtual devices (default 1)\n"
+				 "  -l, --latency MS    reply latency (default 5)\n"
+				 "  -j, --jitter MS     random extra latency 0..MS (default 0)\n"
+				 "  -c, --no-cycle      reply to single cycle without waiting tw\n"
+				 "  -L, --link PREFIX   create symlinks PREFIX0, PREFIX1, ...\n"
+				 "  -s, --seed N        random seed\n",
+				 program);
+}
+
+bool OpenInstance(Instance& instance)
+{
+	instance.master = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+	if (instance.master < 0
+			|| grantpt(instance.master) != 0
+			|| unlockpt(instance.master) != 0)
+	{
+		return false;
+	}
+
+	const char* name = ptsname(instance.master);
+	if (!name) {
+		return false;
+	}
+	instance.path = name;
+
+	// Сырой режим: без эха и преобразования "\r\n"
+	termios settings;
+	if (tcgetattr(instance.master, &settings) == 0) {
+		cfmakeraw(&settings);
+		tcsetattr(instance.master, TCSANOW, &settings);
+	}
+
+	instance.slave = open(name, O_RDWR | O_NOCTTY);
+	if (instance.slave < 0) {
+		return false;
+	}
+
+	if (!instance.link.empty()) {
+		unlink(instance.link.c_str());
+		if (symlink(name, instance.link.c_str()) != 0) {
+			std::perror(instance.link.c_str());
+			instance.link.clear();
+		}
+	}
+	return true;
+}
+
+void Flush(Instance& instance)
+{
+	while (!instance.output.empty()) {
+		const ssize_t written = write(instance.master, instance.output.data(), instance.output.size());
+		if (written <= 0) {
+			return;
+		}
+		instance.output.erase(0, static_cast<size_t>(written));
+	}
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+	int count = 1;
+	VirtualDevice::Settings settings = {5, 0, true, 1};
+	std::string link_prefix;
+
+	const option long_options[] = {
+		{"count", required_argument, nullptr, 'n'},
+		{"latency", required_argument, nullptr, 'l'},
+		{"jitter", required_argument, nullptr, 'j'},
+		{"no-cycle", no_argument, nullptr, 'c'},
+		{"link", required_argument, nullptr, 'L'},
+		{"seed", required_argument, nullptr, 's'},
+		{"help", no_argument, nullptr, 'h'},
+		{nullptr, 0, nullptr, 0}
+	};
+
+	int option_code = 0;
+	while ((option_code = getopt_long(argc, argv, "n:l:j:cL:s:h", long_options, nullptr)) != -1) {
+		switch (option_code) {
+		case 'n': count = std::atoi(optarg); break;
+		case 'l': settings.latency_ms = std::atoi(optarg); break;
+		case 'j': settings.jitter_ms = std::atoi(optarg); break;
+		case 'c': settings.emulate_cycle = false; break;
+		case 'L': link_prefix = optarg; break;
+		case 's': settings.seed = static_cast<unsigned>(std::strtoul(optarg, nullptr, 10)); break;
+		default:
+			Usage(argv[0]);
+			return option_code == 'h' ? 0 : 1;
+		}
+	}
+	if (count < 1) {
+		Usage(argv[0]);
+		return 1;
+	}
+
+	std::signal(SIGINT, Stop);
+	std::signal(SIGTERM, Stop);
+
+	std::vector<Instance> instances;
+	instances.reserve(count);
+	for (int i = 0; i < count; ++i) {
+		VirtualDevice::Settings instance_settings = settings;
+		instance_settings.seed += i;
+		instances.push_back({-1, -1, "", "", VirtualDevice(instance_settings), {}, ""});
+
+		auto& instance = instances.back();
+		if (!link_prefix.empty()) {
+			instance.link = link_prefix + std::to_string(i);
+		}
+		if (!OpenInstance(instance)) {
+			std::perror("pty");
+			return 1;
+		}
+		std::printf("%s%s%s\n",
+					instance.path.c_str(),
+					instance.link.empty() ? "" : " <- ",
+					instance.link.c_str());
+	}
+	std::fflush(stdout);
+
+	std::vector<pollfd> descriptors(instances.size());
+	std::vector<VirtualDevice::Reply> replies;
+	char buffer[4096];
+
+	while (!g_stop) {
+		// Ждём до ближайшего отложенного ответа
+		const auto now = Clock::now();
+		int timeout = -1;
+		for (size_t i = 0; i < instances.size(); ++i) {
+			const auto& instance = instances[i];
+			descriptors[i].fd = instance.master;
+			descriptors[i].events = POLLIN | (instance.output.empty() ? 0 : POLLOUT);
+			descriptors[i].revents = 0;
+			if (!instance.pending.empty()) {
+				const auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(
+							instance.pending.front().due - now).count();
+				const int clamped = wait < 0 ? 0 : static_cast<int>(wait) + 1;
+				timeout = timeout < 0 ? clamped : std::min(timeout, clamped);
+			}
+		}
+
+		if (poll(descriptors.data(), descriptors.size(), timeout) < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			std::perror("poll");
+			break;
+		}
+
+		const auto time = Clock::now();
+		for (size_t i = 0; i < instances.size(); ++i) {
+			auto& instance = instances[i];
+
+			if (descriptors[i].revents & POLLIN) {
+				const ssize_t size = read(instance.master, buffer, sizeof(buffer));
+				if (size > 0) {
+					replies.clear();
+					instance.device.Feed(buffer, static_cast<size_t>(size), replies);
+					for (const auto& reply : replies) {
+						Pending pending = {time + std::chrono::milliseconds(reply.delay_ms), reply.bytes};
+						// Ответы уходят в порядке запросов, даже если задержки разные
+						if (!instance.pending.empty() && pending.due < instance.pending.back().due) {
+							pending.due = instance.pending.back().due;
+						}
+						instance.pending.push_back(pending);
+					}
+				}
+			}
+
+			while (!instance.pending.empty() && instance.pending.front().due <= time) {
+				instance.output += instance.pending.front().bytes;
+				instance.pending.pop_front();
+			}
+			Flush(instance);
+		}
+	}
+
+	for (auto& instance : instances) {
+		std::fprintf(stderr, "%s: %llu requests, %llu crc errors\n",
+					 instance.path.c_str(),
+					 static_cast<unsigned long long>(instance.device.Requests()),
+					 static_cast<unsigned long long>(instance.device.CrcErrors()));
+		if (!instance.link.empty()) {
+			unlink(instance.link.c_str());
+		}
+		close(instance.slave);
+		close(instance.master);
+	}
+	return 0;
+}
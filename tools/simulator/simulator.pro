@@ -0,0 +1,17 @@
+TEMPLATE = app
+
+CONFIG += c++17 console
+CONFIG -= app_bundle qt
+
+TARGET = archipelago-simulator
+
+INCLUDEPATH += ../..
+
+include(../../protocol/protocol.pri)
+
+SOURCES += \
+    main.cpp \
+    virtual-device.cpp
+
+HEADERS += \
+    virtual-device.h
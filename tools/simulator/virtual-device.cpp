@@ -0,0 +1,204 @@
+#include "virtual-device.h"
+#include "codec-kernels.h"
+
+namespace {
+const size_t kMaxRequestLength = 256;
+const int kResistorCycleTime = 300; // длительность цикла от внутреннего резистора (мс)
+
+const uint16_t kNominalVoltage = 2400; // цмр 0.01 В
+const uint16_t kNominalCurrent = 150; // цмр 0.001 А, см. Protocol::kCurrentScale
+
+template <class T>
+void Put(std::vector<uint8_t>& data, T value)
+{
+	for (size_t i = 0; i < sizeof(T); ++i) {
+		data.push_back(static_cast<uint8_t>(value & 0xFF));
+		value >>= 8;
+	}
+}
+
+template <class T>
+T Get(const std::vector<uint8_t>& data, size_t& offset)
+{
+	uint32_t value = 0;
+	for (size_t i = 0; i < sizeof(T); ++i) {
+		value |= static_cast<uint32_t>(data[offset + i]) << (8 * i);
+	}
+	offset += sizeof(T);
+	return static_cast<T>(value);
+}
+}
+
+VirtualDevice::VirtualDevice(const Settings& settings)
+	: _settings(settings)
+	, _random(settings.seed)
+	, _cycles(0)
+	, _time(0)
+	, _time_base(Clock::now())
+	, _cpm(2000)
+	, _tp(5000)
+	, _tbc(10000)
+	, _tbtp(3600)
+	, _ct(0xFF)
+	, _tw(200)
+	, _requests(0)
+	, _crc_errors(0)
+{
+}
+
+void VirtualDevice::Feed(const char* data, size_t size, std::vector<Reply>& replies)
+{
+	for (size_t i = 0; i < size; ++i) {
+		const char c = data[i];
+
+		// '@' всегда начинает новый запрос, мусор до него отбрасывается
+		if (c == '@') {
+			_request.assign(1, c);
+			continue;
+		}
+		if (_request.empty()) {
+			continue;
+		}
+
+		_request.push_back(c);
+		if (_request.size() > kMaxRequestLength) {
+			_request.clear();
+			continue;
+		}
+
+		if (c == '\n' && _request.size() >= 2 && _request[_request.size() - 2] == '\r') {
+			Reply reply;
+			if (Handle(_request.substr(1, _request.size() - 3), reply)) {
+				replies.push_back(reply);
+			}
+			_request.clear();
+		}
+	}
+}
+
+uint64_t VirtualDevice::Requests() const
+{
+	return _requests;
+}
+
+uint64_t VirtualDevice::CrcErrors() const
+{
+	return _crc_errors;
+}
+
+bool VirtualDevice::Handle(const std::string& request, Reply& reply)
+{
+	++_requests;
+
+	// Пинг приходит без CRC
+	if (request == "55") {
+		reply = {Frame("55", {}), Delay()};
+		return true;
+	}
+
+	// Остальные запросы: код, данные и CRC в hex
+	if (request.size() < 4 || request.size() % 2) {
+		return false;
+	}
+	std::vector<uint8_t> body(request.size() / 2);
+	if (!Kernels::HexDecode(request.data(), body.size(), body.data())) {
+		return false;
+	}
+	const uint8_t crc = body.back();
+	body.pop_back();
+	if (Kernels::Crc8(body.data(), body.size()) != crc) {
+		++_crc_errors;
+		return false;
+	}
+
+	const uint8_t code = body.front();
+	const std::vector<uint8_t> data(body.begin() + 1, body.end());
+	std::vector<uint8_t> payload;
+	size_t offset = 0;
+
+	switch (code) {
+	case 0x20:
+		Put<uint32_t>(payload, _cycles);
+		Put<uint32_t>(payload, UpTime());
+		reply = {Frame("20", payload), Delay()};
+		return true;
+
+	case 0x2F:
+		if (data.size() != 8) {
+			return false;
+		}
+		_cycles = Get<uint32_t>(data, offset);
+		_time = Get<uint32_t>(data, offset);
+		_time_base = Clock::now();
+		reply = {Frame("2F", {}), Delay()};
+		return true;
+
+	case 0x30:
+		Put<uint16_t>(payload, _cpm);
+		Put<uint16_t>(payload, _tp);
+		Put<uint16_t>(payload, _tbc);
+		Put<uint16_t>(payload, _tbtp);
+		Put<uint8_t>(payload, _ct);
+		Put<uint16_t>(payload, _tw);
+		reply = {Frame("30", payload), Delay()};
+		return true;
+
+	case 0x3F:
+		if (data.size() != 11) {
+			return false;
+		}
+		_cpm = Get<uint16_t>(data, offset);
+		_tp = Get<uint16_t>(data, offset);
+		_tbc = Get<uint16_t>(data, offset);
+		_tbtp = Get<uint16_t>(data, offset);
+		_ct = Get<uint8_t>(data, offset);
+		_tw = Get<uint16_t>(data, offset);
+		reply = {Frame("3F", {}), Delay()};
+		return true;
+
+	case 0x40: {
+		++_cycles;
+		std::uniform_int_distribution<int> noise(-20, 20);
+		Put<uint16_t>(payload, static_cast<uint16_t>(kNominalVoltage + noise(_random)));
+		Put<uint16_t>(payload, static_cast<uint16_t>(kNominalCurrent + noise(_random) / 4));
+		reply = {Frame("40", payload), Delay() + (_settings.emulate_cycle ? CycleTime() : 0)};
+		return true;
+	}
+
+	default:
+		return false;
+	}
+}
+
+uint32_t VirtualDevice::UpTime() const
+{
+	const auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(Clock::now() - _time_base);
+	return _time + static_cast<uint32_t>(elapsed.count());
+}
+
+int VirtualDevice::Delay()
+{
+	if (_settings.jitter_ms <= 0) {
+		return _settings.latency_ms;
+	}
+	std::uniform_int_distribution<int> jitter(0, _settings.jitter_ms);
+	return _settings.latency_ms + jitter(_random);
+}
+
+int VirtualDevice::CycleTime() const
+{
+	return _ct == 0xFF ? _tw : kResistorCycleTime;
+}
+
+std::string VirtualDevice::Frame(const std::string& code, const std::vector<uint8_t>& data) const
+{
+	std::string hex(2 * data.size(), '\0');
+	Kernels::HexEncode(data.data(), data.size(), &hex[0], true);
+
+	std::string body = code + hex;
+	const uint8_t crc = Kernels::Crc8Hex(body.data(), body.size());
+	char crc_hex[2];
+	Kernels::HexEncode(&crc, 1, crc_hex, true);
+
+	return "$" + body + std::string(crc_hex, 2) + "\r\n";
+}
@@ -0,0 +1,67 @@
+#ifndef VIRTUALDEVICE_H
+#define VIRTUALDEVICE_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+// Модель контроллера насоса на уровне протокола: принимает байты запросов
+// "@<код><данные><CRC>\r\n" и формирует ответы "$...". Ввод-вывод не делает,
+// поэтому один процесс может держать сколько угодно устройств.
+class VirtualDevice
+{
+public:
+	struct Settings {
+		int latency_ms; // задержка ответа
+		int jitter_ms; // случайная добавка к задержке [0 .. jitter_ms]
+		bool emulate_cycle; // ответ на пуск цикла после его длительности
+		unsigned seed;
+	};
+
+	struct Reply {
+		std::string bytes;
+		int delay_ms;
+	};
+
+	explicit VirtualDevice(const Settings&);
+
+	// Готовые ответы добавляются в replies
+	void Feed(const char* data, size_t size, std::vector<Reply>& replies);
+
+	// Счётчики запросов
+	uint64_t Requests() const;
+	uint64_t CrcErrors() const;
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	Settings _settings;
+	std::string _request; // текущий недособранный запрос
+	std::mt19937 _random;
+
+	uint32_t _cycles;
+	uint32_t _time; // время работы на момент _time_base (с)
+	Clock::time_point _time_base;
+
+	uint16_t _cpm;
+	uint16_t _tp;
+	uint16_t _tbc;
+	uint16_t _tbtp;
+	uint8_t _ct;
+	uint16_t _tw;
+
+	uint64_t _requests;
+	uint64_t _crc_errors;
+
+private:
+	bool Handle(const std::string& request, Reply&);
+	uint32_t UpTime() const;
+	int Delay();
+	int CycleTime() const;
+	std::string Frame(const std::string& code, const std::vector<uint8_t>& data) const;
+};
+
+#endif // VIRTUALDEVICE_H
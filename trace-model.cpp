@@ -0,0 +1,115 @@
+#include "trace-model.h"
+#include <QTimer>
+
+namespace {
+const int kFrameInterval = 16; // мс, ~60 кадров в секунду
+}
+
+TraceModel::TraceModel(int capacity, QObject *parent)
+	: QAbstractListModel(parent)
+	, _lines(qMax(1, capacity))
+	, _first(0)
+	, _size(0)
+	, _flush_timer(new QTimer(this))
+{
+	_flush_timer->setSingleShot(true);
+	_flush_timer->setInterval(kFrameInterval);
+	connect(_flush_timer, &QTimer::timeout, this, &TraceModel::Flush);
+}
+
+int TraceModel::Capacity() const
+{
+	return static_cast<int>(_lines.size());
+}
+
+void TraceModel::SetCapacity(int capacity)
+{
+	capacity = qMax(1, capacity);
+	if (capacity == Capacity()) {
+		return;
+	}
+
+	// Сохраняются самые новые строки
+	beginResetModel();
+	const int keep = qMin(_size, capacity);
+	std::vector<QString> lines(capacity);
+	for (int i = 0; i < keep; ++i) {
+		lines[i] = _lines[(_first + _size - keep + i) % Capacity()];
+	}
+	_lines.swap(lines);
+	_first = 0;
+	_size = keep;
+	endResetModel();
+}
+
+int TraceModel::rowCount(const QModelIndex &parent) const
+{
+	return parent.isValid() ? 0 : _size;
+}
+
+QVariant TraceModel::data(const QModelIndex &index, int role) const
+{
+	if (role != Qt::DisplayRole
+			|| !index.isValid()
+			|| index.row() >= _size)
+	{
+		return QVariant();
+	}
+	return _lines[(_first + index.row()) % Capacity()];
+}
+
+void TraceModel::Append(const QString& line)
+{
+	_pending.append(line);
+	if (!_flush_timer->isActive()) {
+		_flush_timer->start();
+	}
+}
+
+void TraceModel::Clear()
+{
+	_flush_timer->stop();
+	_pending.clear();
+
+	beginResetModel();
+	for (auto& line : _lines) {
+		line.clear();
+	}
+	_first = 0;
+	_size = 0;
+	endResetModel();
+}
+
+void TraceModel::Flush()
+{
+	const int capacity = Capacity();
+
+	// Из пачки больше ёмкости нужен только хвост
+	if (_pending.size() > capacity) {
+		_pending.erase(_pending.begin(), _pending.end() - capacity);
+	}
+	const int count = _pending.size();
+	if (!count) {
+		return;
+	}
+
+	const int overflow = _size + count - capacity;
+	if (overflow > 0) {
+		beginRemoveRows(QModelIndex(), 0, overflow - 1);
+		for (int i = 0; i < overflow; ++i) {
+			_lines[(_first + i) % capacity].clear();
+		}
+		_first = (_first + overflow) % capacity;
+		_size -= overflow;
+		endRemoveRows();
+	}
+
+	beginInsertRows(QModelIndex(), _size, _size + count - 1);
+	for (const auto& line : _pending) {
+		_lines[(_first + _size) % capacity] = line;
+		++_size;
+	}
+	endInsertRows();
+
+	_pending.clear();
+}
@@ -0,0 +1,40 @@
+#ifndef TRACEMODEL_H
+#define TRACEMODEL_H
+
+#include <QAbstractListModel>
+#include <QStringList>
+#include <vector>
+
+class QTimer;
+
+// Журнал обмена фиксированной ёмкости: старые строки вытесняются новыми.
+// Поступающие строки копятся и попадают в модель пачкой не чаще раза за кадр.
+class TraceModel : public QAbstractListModel
+{
+	Q_OBJECT
+
+public:
+	explicit TraceModel(int capacity = 10000, QObject *parent = nullptr);
+
+	int Capacity() const;
+	void SetCapacity(int);
+
+	int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+	QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+
+public slots:
+	void Append(const QString&);
+	void Clear();
+
+private:
+	std::vector<QString> _lines; // кольцевой буфер
+	int _first; // индекс самой старой строки
+	int _size;
+	QStringList _pending;
+	QTimer* _flush_timer;
+
+private:
+	void Flush();
+};
+
+#endif // TRACEMODEL_H
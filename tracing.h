@@ -0,0 +1,79 @@
+#ifndef TRACING_H
+#define TRACING_H
+
+#include <QMetaType>
+#include <atomic>
+
+// Трассировка по уровням и категориям. Отключённая запись стоит одну
+// проверку: текст сообщения формируется только для включённых записей.
+// Уровни ниже TRACING_MIN_LEVEL вырезаются при компиляции.
+namespace Tracing {
+
+enum class Level {
+	Debug,
+	Info,
+	Warning,
+	Error
+};
+
+enum Category : unsigned {
+	Io = 0x01, // обмен с портом
+	Crc = 0x02, // ошибки контрольной суммы
+	Discovery = 0x04, // поиск устройств
+	State = 0x08, // последовательность команд
+	AllCategories = 0x0F
+};
+
+// Направление кадра для двоичных событий обмена
+enum class Direction {
+	Out,
+	In
+};
+
+#ifndef TRACING_MIN_LEVEL
+#define TRACING_MIN_LEVEL 0
+#endif
+
+constexpr Level kMinLevel = static_cast<Level>(TRACING_MIN_LEVEL);
+
+inline std::atomic<unsigned> g_categories(AllCategories);
+inline std::atomic<int> g_level(static_cast<int>(Level::Warning));
+
+inline void SetCategories(unsigned categories)
+{
+	g_categories.store(categories, std::memory_order_relaxed);
+}
+
+inline void SetLevel(Level level)
+{
+	g_level.store(static_cast<int>(level), std::memory_order_relaxed);
+}
+
+inline bool IsEnabled(Category category, Level level)
+{
+	return level >= kMinLevel
+			&& static_cast<int>(level) >= g_level.load(std::memory_order_relaxed)
+			&& (g_categories.load(std::memory_order_relaxed) & category);
+}
+
+}
+
+Q_DECLARE_METATYPE(Tracing::Direction)
+
+// Выражение message вычисляется, только если запись включена
+#define TRACE(category, level, message) \
+	do { \
+		if (Tracing::IsEnabled(Tracing::category, Tracing::Level::level)) { \
+			emit Trace(message); \
+		} \
+	} while (0)
+
+// Кадр передаётся как есть, без перевода в текст
+#define TRACE_FRAME(direction, frame) \
+	do { \
+		if (Tracing::IsEnabled(Tracing::Io, Tracing::Level::Debug)) { \
+			emit TraceFrame(Tracing::Direction::direction, frame); \
+		} \
+	} while (0)
+
+#endif // TRACING_H